@@ -0,0 +1,134 @@
+#include <bitset>
+#include <cassert>
+#include <vector>
+
+#include "bitboard.h"
+#include "endgame.h"
+
+// KPK bitbase from Stockfish. Every position with the pawn on files A-D is classified by
+// iterating over all of them until no more results change, and the wins are kept.
+
+namespace {
+
+    // Bits 0-5 white king, 6-11 black king, 12 side to move, 13-14 pawn file and
+    // 15-17 the distance of the pawn from the seventh rank
+    constexpr unsigned MAX_INDEX = 2 * 24 * 64 * 64;
+
+    std::bitset<MAX_INDEX> KPKBitbase;
+
+    unsigned index(Colour us, Square blackKing, Square whiteKing, Square pawn) {
+        return whiteKing | (blackKing << 6) | (us << 12) | (getFile(pawn) << 13) | ((RANK_7 - getRank(pawn)) << 15);
+    }
+
+    enum Result { INVALID = 0, UNKNOWN = 1, DRAW = 2, WIN = 4 };
+
+    Result& operator|=(Result& r, Result v) { return r = Result(r | v); }
+
+    struct KPKPosition {
+        KPKPosition() = default;
+        explicit KPKPosition(unsigned idx);
+        operator Result() const { return result; }
+
+        Result classify(const std::vector<KPKPosition>& db) {
+            return us == WHITE ? classify<WHITE>(db) : classify<BLACK>(db);
+        }
+
+        template<Colour Us>
+        Result classify(const std::vector<KPKPosition>& db);
+
+        Colour us;
+        Square kings[COLOUR_COUNT], pawn;
+        Result result;
+    };
+
+    KPKPosition::KPKPosition(unsigned idx) {
+        kings[WHITE] = Square((idx >> 0) & 0x3F);
+        kings[BLACK] = Square((idx >> 6) & 0x3F);
+        us = Colour((idx >> 12) & 0x01);
+        pawn = makeSquare(File((idx >> 13) & 0x3), Rank(RANK_7 - ((idx >> 15) & 0x7)));
+
+        // Two pieces on one square, or a king that can be captured
+        if(lookups::distance(kings[WHITE], kings[BLACK]) <= 1
+            || kings[WHITE] == pawn
+            || kings[BLACK] == pawn
+            || (us == WHITE && (lookups::pawn(pawn, WHITE) & bitShift(kings[BLACK])))) {
+            result = INVALID;
+        }
+        // The pawn promotes without being captured
+        else if(us == WHITE
+            && getRank(pawn) == RANK_7
+            && kings[WHITE] != pawn + NORTH
+            && (lookups::distance(kings[BLACK], pawn + NORTH) > 1
+                || (lookups::king(kings[WHITE]) & bitShift(pawn + NORTH)))) {
+            result = WIN;
+        }
+        // Stalemate, or the black king takes an undefended pawn
+        else if(us == BLACK
+            && (!(lookups::king(kings[BLACK]) & ~(lookups::king(kings[WHITE]) | lookups::pawn(pawn, WHITE)))
+                || (lookups::king(kings[BLACK]) & bitShift(pawn) & ~lookups::king(kings[WHITE])))) {
+            result = DRAW;
+        }
+        else {
+            result = UNKNOWN;
+        }
+    }
+
+    // White wins if any move reaches a win and draws if all moves reach a draw. Black
+    // draws if any move reaches a draw and loses if all moves reach a win.
+    template<Colour Us>
+    Result KPKPosition::classify(const std::vector<KPKPosition>& db) {
+        constexpr Colour Them = ~Us;
+        constexpr Result Good = Us == WHITE ? WIN : DRAW;
+        constexpr Result Bad = Us == WHITE ? DRAW : WIN;
+
+        Result r = INVALID;
+        Bitboard b = lookups::king(kings[Us]);
+
+        while(b) {
+            r |= Us == WHITE ? db[index(Them, kings[Them], popLsb(b), pawn)]
+                             : db[index(Them, popLsb(b), kings[Them], pawn)];
+        }
+
+        if(Us == WHITE) {
+            if(getRank(pawn) < RANK_7) {
+                r |= db[index(Them, kings[Them], kings[Us], pawn + NORTH)];
+            }
+
+            if(getRank(pawn) == RANK_2
+                && pawn + NORTH != kings[Us]
+                && pawn + NORTH != kings[Them]) {
+                r |= db[index(Them, kings[Them], kings[Us], pawn + NORTH + NORTH)];
+            }
+        }
+
+        return result = r & Good ? Good : r & UNKNOWN ? UNKNOWN : Bad;
+    }
+}
+
+void Bitbases::init() {
+    std::vector<KPKPosition> db(MAX_INDEX);
+    unsigned idx, repeat = 1;
+
+    for(idx = 0; idx < MAX_INDEX; ++idx) {
+        db[idx] = KPKPosition(idx);
+    }
+
+    while(repeat) {
+        for(repeat = idx = 0; idx < MAX_INDEX; ++idx) {
+            repeat |= (db[idx] == UNKNOWN && db[idx].classify(db) != UNKNOWN);
+        }
+    }
+
+    for(idx = 0; idx < MAX_INDEX; ++idx) {
+        if(db[idx] == WIN) {
+            KPKBitbase.set(idx);
+        }
+    }
+}
+
+// The pawn must be on files A-D, with the board mirrored by the caller if needed
+bool Bitbases::probe(Square whiteKing, Square whitePawn, Square blackKing, Colour us) {
+    assert(getFile(whitePawn) <= FILE_D);
+
+    return KPKBitbase[index(us, blackKing, whiteKing, whitePawn)];
+}
@@ -3,381 +3,113 @@
 #include <iostream>
 #include <algorithm>
 
-// From Teki
-int distanceVal[64][64];
-Bitboard attacksRay[64][64];
-Bitboard attacksXray[64][64];
-Bitboard attacksFullRay[64][64];
-Bitboard attacksInterveningRay[64][64];
-Bitboard adjacentFiles[64];
-Bitboard adjacentSquares[64];
-Bitboard maskFile[64];
-Bitboard maskRank[64];
+Bitboard rookTable[0x19000];
+Bitboard bishopTable[0x1480];
 
-Bitboard attacksPawn[2][64];
-Bitboard attacksKnight[64];
-Bitboard attacksBishop[64];
-Bitboard attacksRook[64];
-Bitboard attacksQueen[64];
-Bitboard attacksKing[64];
-
-Bitboard north[64];
-Bitboard south[64];
-Bitboard east[64];
-Bitboard west[64];
-Bitboard northeast[64];
-Bitboard northwest[64];
-Bitboard southeast[64];
-Bitboard southwest[64];
-Bitboard northRegion[64];
-Bitboard southRegion[64];
-Bitboard eastRegion[64];
-Bitboard westRegion[64];
-
-Bitboard passedPawnMask[64];
-Bitboard outpostMask[64];
-Bitboard kingThreats[64];
-Bitboard kingShelters[64][2];
-
-void init_non_sliders() {
-    for(Square square = A1; square < SQUARE_COUNT; ++square) {
-        attacksKing[square] = attacksKnight[square] = 0;
-        attacksPawn[WHITE][square] = attacksPawn[BLACK][square] = 0;
-
-        // Pawn attacks
-        attacksPawn[WHITE][square] |= ((getBit(square + 7) & ~FILE_H_MASK)
-            | (getBit(square + 9) & ~FILE_A_MASK))
-            & ~RANK_1_MASK;
-        attacksPawn[BLACK][square] |= ((getBit(square - 7) & ~FILE_A_MASK)
-            | (getBit(square - 9) & ~FILE_H_MASK))
-            & ~RANK_8_MASK;
-
-        // Knight attacks
-        attacksKnight[square] |= getBit(square + 17) & ~(FILE_A_MASK | RANK_2_MASK | RANK_1_MASK);
-        attacksKnight[square] |= getBit(square + 15) & ~(FILE_H_MASK | RANK_2_MASK | RANK_1_MASK);
-        attacksKnight[square] |= getBit(square - 17) & ~(FILE_H_MASK | RANK_7_MASK | RANK_8_MASK);
-        attacksKnight[square] |= getBit(square - 15) & ~(FILE_A_MASK | RANK_7_MASK | RANK_8_MASK);
-        attacksKnight[square] |= getBit(square - 10) & ~(FILE_H_MASK | FILE_G_MASK | RANK_8_MASK);
-        attacksKnight[square] |= getBit(square + 6) & ~(FILE_H_MASK | FILE_G_MASK | RANK_1_MASK);
-        attacksKnight[square] |= getBit(square + 10) & ~(FILE_A_MASK | FILE_B_MASK | RANK_1_MASK);
-        attacksKnight[square] |= getBit(square - 6) & ~(FILE_A_MASK | FILE_B_MASK | RANK_8_MASK);
-
-        // King attacks
-        attacksKing[square] |= getBit(square + 8) & ~RANK_1_MASK;
-        attacksKing[square] |= getBit(square - 8) & ~RANK_8_MASK;
-        attacksKing[square] |= getBit(square + 1) & ~FILE_A_MASK;
-        attacksKing[square] |= getBit(square - 1) & ~FILE_H_MASK;
-        attacksKing[square] |= getBit(square + 9) & ~(FILE_A_MASK | RANK_1_MASK);
-        attacksKing[square] |= getBit(square - 9) & ~(FILE_H_MASK | RANK_8_MASK);
-        attacksKing[square] |= getBit(square + 7) & ~(FILE_H_MASK | RANK_1_MASK);
-        attacksKing[square] |= getBit(square - 7) & ~(FILE_A_MASK | RANK_8_MASK);
-    }
-}
-
-void init_pseudo_sliders()
+// Slow ray walking versions of the slider attacks, only used to fill the magic tables
+Bitboard bishop_rays(int square, Bitboard occupancy)
 {
-    for(Square square = A1; square < SQUARE_COUNT; ++square) {
-        attacksBishop[square] = lookups::getNortheast(square) | lookups::getNorthwest(square)
-            | lookups::getSoutheast(square) | lookups::getSouthwest(square);
-        attacksRook[square] = lookups::getNorth(square) | lookups::getSouth(square)
-            | lookups::getEast(square) | lookups::getWest(square);
-        attacksQueen[square] = attacksRook[square] | attacksBishop[square];
-    }
+    Bitboard atk = lookups::bishop(square);
+    Bitboard nw_blockers = (lookups::getNorthwest(square) & occupancy) | getBit(A8);
+    Bitboard ne_blockers = (lookups::getNortheast(square) & occupancy) | getBit(H8);
+    Bitboard sw_blockers = (lookups::getSouthwest(square) & occupancy) | getBit(A1);
+    Bitboard se_blockers = (lookups::getSoutheast(square) & occupancy) | getBit(H1);
+
+    atk ^= lookups::getNorthwest(fbitscan(nw_blockers));
+    atk ^= lookups::getNortheast(fbitscan(ne_blockers));
+    atk ^= lookups::getSouthwest(rbitscan(sw_blockers));
+    atk ^= lookups::getSoutheast(rbitscan(se_blockers));
+
+    return atk;
 }
 
-void init_misc()
+Bitboard rook_rays(int square, Bitboard occupancy)
 {
-    Square high = NO_SQUARE;
-    Square low = NO_SQUARE;
-    for(Square i = A1; i < SQUARE_COUNT; ++i) {
-        maskFile[i] = lookups::getNorth(i) | lookups::getSouth(i) | getBit(i);
-        maskRank[i] = lookups::getEast(i) | lookups::getWest(i) | getBit(i);
-        passedPawnMask[i] = 0;
-        if(getFile(i) != FILE_A) {
-            passedPawnMask[i] |= north[i - 1] | north[i];
-            adjacentFiles[i] |= getBit(i - 1) | north[i - 1] | south[i - 1];
-            adjacentSquares[i] |= getBit(i - 1);
-        }
-        if(getFile(i) != FILE_H) {
-            passedPawnMask[i] |= north[i + 1] | north[i];
-            adjacentFiles[i] |= getBit(i + 1) | north[i + 1] | south[i + 1];
-            adjacentSquares[i] |= getBit(i + 1);
-        }
-        for(Square j = A1; j < SQUARE_COUNT; ++j) {
-            distanceVal[i][j] = std::max(abs(int(getRank(i)) - int(getRank(j))),
-                abs(int(getFile(i)) - int(getFile(j))));
-            attacksInterveningRay[i][j] = 0;
-            if(i == j)
-                continue;
-            high = j;
-            if(i > j) {
-                high = i;
-                low = j;
-            }
-            else
-                low = i;
-            if(getFile(high) == getFile(low))
-            {
-                attacksFullRay[i][j] =
-                    (lookups::rook(high) & lookups::rook(low)) | getBit(i) | getBit(j);
-                attacksXray[low][high] = lookups::getNorth(low);
-                attacksXray[high][low] = lookups::getSouth(high);
-                attacksRay[i][j] = getBit(high);
-                for(high -= 8; high >= low; high -= 8) {
-                    attacksRay[i][j] |= getBit(high);
-                    if(high != low)
-                        attacksInterveningRay[i][j] |= getBit(high);
-                }
-            }
-            else if(getRank(high) == getRank(low))
-            {
-                attacksFullRay[i][j] =
-                    (lookups::rook(high) & lookups::rook(low)) | getBit(i) | getBit(j);
-                attacksXray[low][high] = lookups::getEast(low);
-                attacksXray[high][low] = lookups::getWest(high);
-                attacksRay[i][j] = getBit(high);
-                for(--high; high >= low; --high) {
-                    attacksRay[i][j] |= getBit(high);
-                    if(high != low)
-                        attacksInterveningRay[i][j] |= getBit(high);
-                }
-            }
-            else if(getRank(high) - getRank(low) == getFile(high) - getFile(low))
-            {
-                attacksFullRay[i][j] =
-                    (lookups::bishop(high) & lookups::bishop(low)) | getBit(i) | getBit(j);
-                attacksXray[low][high] = lookups::getNortheast(low);
-                attacksXray[high][low] = lookups::getSouthwest(high);
-                attacksRay[i][j] = getBit(high);
-                for(high -= 9; high >= low; high -= 9) {
-                    attacksRay[i][j] |= getBit(high);
-                    if(high != low)
-                        attacksInterveningRay[i][j] |= getBit(high);
-                }
-            }
-            else if(getRank(high) - getRank(low) == getFile(low) - getFile(high))
-            {
-                attacksFullRay[i][j] =
-                    (lookups::bishop(high) & lookups::bishop(low)) | getBit(i) | getBit(j);
-                attacksXray[low][high] = lookups::getNorthwest(low);
-                attacksXray[high][low] = lookups::getSoutheast(high);
-                attacksRay[i][j] = getBit(high);
-                for(high -= 7; high >= low; high -= 7) {
-                    attacksRay[i][j] |= getBit(high);
-                    if(high != low)
-                        attacksInterveningRay[i][j] |= getBit(high);
-                }
-            }
-        }
-    }
-    for(Square square = A1; square < SQUARE_COUNT; ++square) {
-        outpostMask[square] = passedPawnMask[square] & maskFile[square];
-    }
+    Bitboard atk = lookups::rook(square);
+    Bitboard n_blockers = (lookups::getNorth(square) & occupancy) | getBit(H8);
+    Bitboard s_blockers = (lookups::getSouth(square) & occupancy) | getBit(A1);
+    Bitboard e_blockers = (lookups::getEast(square) & occupancy) | getBit(H8);
+    Bitboard w_blockers = (lookups::getWest(square) & occupancy) | getBit(A1);
+
+    atk ^= lookups::getNorth(fbitscan(n_blockers));
+    atk ^= lookups::getSouth(rbitscan(s_blockers));
+    atk ^= lookups::getEast(fbitscan(e_blockers));
+    atk ^= lookups::getWest(rbitscan(w_blockers));
+
+    return atk;
 }
 
-void init_directions() {
-    Bitboard ne, nw, se, sw;
-    Bitboard n, w, s, e;
-    Bitboard ne_mask, nw_mask, se_mask, sw_mask;
-    Bitboard n_mask, w_mask, s_mask, e_mask;
-    nw_mask = ~(RANK_1_MASK | FILE_H_MASK);
-    ne_mask = ~(RANK_1_MASK | FILE_A_MASK);
-    sw_mask = ~(RANK_8_MASK | FILE_H_MASK);
-    se_mask = ~(RANK_8_MASK | FILE_A_MASK);
-    n_mask = ~(RANK_1_MASK);
-    e_mask = ~(FILE_A_MASK);
-    s_mask = ~(RANK_8_MASK);
-    w_mask = ~(FILE_H_MASK);
+// From Stockfish. Magics are searched for at startup with a fixed seed per rank, which
+// finds all of them within a few milliseconds.
+void init_magics(Bitboard table[], Magic magics[], Bitboard (*rays)(int, Bitboard)) {
+    constexpr uint64_t seeds[RANK_COUNT] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
 
-    for(Square square = A1; square < SQUARE_COUNT; ++square) {
-        Bitboard sq_bb = getBit(square);
+    Bitboard occupancy[4096], reference[4096];
+    int epoch[4096] = { 0 }, count = 0;
 
-        nw = (sq_bb << 7) & nw_mask;
-        ne = (sq_bb << 9) & ne_mask;
-        sw = (sq_bb >> 9) & sw_mask;
-        se = (sq_bb >> 7) & se_mask;
-        n = (sq_bb << 8) & n_mask;
-        e = (sq_bb << 1) & e_mask;
-        s = (sq_bb >> 8) & s_mask;
-        w = (sq_bb >> 1) & w_mask;
+    for(Square square = A1; square < SQUARE_COUNT; ++square) {
+        Bitboard edges = ((RANK_1_MASK | RANK_8_MASK) & ~lookups::rankMask(square))
+            | ((FILE_A_MASK | FILE_H_MASK) & ~lookups::fileMask(square));
+
+        Magic& m = magics[square];
+        m.mask = rays(square, 0) & ~edges;
+        m.shift = 64 - popCount(m.mask);
+        m.attacks = square == A1 ? table : magics[square - 1].attacks + (size_t(1) << popCount(magics[square - 1].mask));
+
+        // Enumerate every subset of the mask (Carry-Rippler trick)
+        int size = 0;
+        Bitboard b = 0;
+        do {
+            occupancy[size] = b;
+            reference[size] = rays(square, b);
+            if(usePext) {
+                m.attacks[pext(b, m.mask)] = reference[size];
+            }
+            ++size;
+            b = (b - m.mask) & m.mask;
+        } while(b);
 
-        for(int times = 0; times < 6; ++times) {
-            nw |= (nw << 7) & nw_mask;
-            ne |= (ne << 9) & ne_mask;
-            sw |= (sw >> 9) & sw_mask;
-            se |= (se >> 7) & se_mask;
-            n |= (n << 8) & n_mask;
-            e |= (e << 1) & e_mask;
-            s |= (s >> 8) & s_mask;
-            w |= (w >> 1) & w_mask;
+        if(usePext) {
+            continue;
         }
 
-        north[square] = n;
-        south[square] = s;
-        east[square] = e;
-        west[square] = w;
-        northeast[square] = ne;
-        northwest[square] = nw;
-        southeast[square] = se;
-        southwest[square] = sw;
-    }
-}
+        uint64_t seed = seeds[getRank(square)];
+        auto next = [&seed]() {
+            seed ^= seed >> 12, seed ^= seed << 25, seed ^= seed >> 27;
+            return seed * 2685821657736338717ULL;
+        };
 
-void init_eval_masks() {
-    for(Square i = A1; i < SQUARE_COUNT; ++i) {
-        kingThreats[i] =
-            getBit(i)
-            | lookups::king(i)
-            | (lookups::king(i) >> 8);
-        kingShelters[i][WHITE] = kingShelters[i][BLACK] = getBit(i) | lookups::king(i);
-        if(i < 8) {
-            kingShelters[i][WHITE] |=  lookups::king(i + 8);
-        }
-        if(i > 55) {
-            kingShelters[i][BLACK] |= lookups::king(i - 8);
-        }
-    }
-}
+        for(int i = 0; i < size; ) {
+            for(m.magic = 0; popCount((m.magic * m.mask) >> 56) < 6; ) {
+                m.magic = next() & next() & next();
+            }
 
-void init_regions() {
-    Bitboard nr, wr, sr, er;
-    for(Square square = A1; square < SQUARE_COUNT; ++square) {
-        nr = wr = sr = er = 0ULL;
-        for(int r = getRank(square) + 1; r <= RANK_8; ++r)
-            nr |= lookups::rankMask(getSquare(FILE_A, r));
-        for(int r = getRank(square) - 1; r >= RANK_1; --r)
-            sr |= lookups::rankMask(getSquare(FILE_A, r));
-        for(int f = getFile(square) + 1; f <= FILE_H; ++f)
-            er |= lookups::fileMask(getSquare(f, RANK_1));
-        for(int f = getFile(square) - 1; f >= FILE_A; --f)
-            wr |= lookups::fileMask(getSquare(f, RANK_1));
+            // A magic fails as soon as two occupancies with different attacks map to the
+            // same slot. The epoch counter avoids clearing the slice between attempts.
+            for(++count, i = 0; i < size; ++i) {
+                unsigned idx = m.index(occupancy[i]);
 
-        northRegion[square] = nr;
-        southRegion[square] = sr;
-        eastRegion[square] = er;
-        westRegion[square] = wr;
+                if(epoch[idx] < count) {
+                    epoch[idx] = count;
+                    m.attacks[idx] = reference[i];
+                }
+                else if(m.attacks[idx] != reference[i]) {
+                    break;
+                }
+            }
+        }
     }
 }
 
 namespace lookups
 {
-    void init() {
-        init_non_sliders();
-        init_directions();
-        init_pseudo_sliders();
-        init_misc();
-        init_eval_masks();
-        init_regions();
-    }
-
-    int distance(int from, int to) { return distanceVal[from][to]; }
-    Bitboard ray(int from, int to) { return attacksRay[from][to]; }
-    Bitboard xray(int from, int to) { return attacksXray[from][to]; }
-    Bitboard full_ray(int from, int to) { return attacksFullRay[from][to]; }
-    Bitboard intervening_sqs(int from, int to) { return attacksInterveningRay[from][to]; }
-    Bitboard adjacent_files(int square) { return adjacentFiles[square]; }
-    Bitboard adjacent_sqs(int square) { return adjacentSquares[square]; }
-    Bitboard fileMask(int square) { return maskFile[square]; }
-    Bitboard rankMask(int square) { return maskRank[square]; }
-
-    Bitboard getNorth(int square) { return north[square]; }
-    Bitboard getSouth(int square) { return south[square]; }
-    Bitboard getEast(int square) { return east[square]; }
-    Bitboard getWest(int square) { return west[square]; }
-    Bitboard getNortheast(int square) { return northeast[square]; }
-    Bitboard getNorthwest(int square) { return northwest[square]; }
-    Bitboard getSoutheast(int square) { return southeast[square]; }
-    Bitboard getSouthwest(int square) { return southwest[square]; }
-    Bitboard getNorthRegion(int square) { return northRegion[square]; }
-    Bitboard getSouthRegion(int square) { return southRegion[square]; }
-    Bitboard getEastRegion(int square) { return eastRegion[square]; }
-    Bitboard getWestRegion(int square) { return westRegion[square]; }
-
-    Bitboard pawn(int square, int side) { return attacksPawn[side][square]; }
-    Bitboard knight(int square) { return attacksKnight[square]; }
-    Bitboard bishop(int square) { return attacksBishop[square]; }
-    Bitboard rook(int square) { return attacksRook[square]; }
-    Bitboard queen(int square) { return attacksQueen[square]; }
-    Bitboard king(int square) { return attacksKing[square]; }
-
-    Bitboard bishop(int square, Bitboard occupancy)
-    {
-        Bitboard atk = bishop(square);
-        Bitboard nw_blockers = (getNorthwest(square) & occupancy) | getBit(A8);
-        Bitboard ne_blockers = (getNortheast(square) & occupancy) | getBit(H8);
-        Bitboard sw_blockers = (getSouthwest(square) & occupancy) | getBit(A1);
-        Bitboard se_blockers = (getSoutheast(square) & occupancy) | getBit(H1);
-
-        atk ^= getNorthwest(fbitscan(nw_blockers));
-        atk ^= getNortheast(fbitscan(ne_blockers));
-        atk ^= getSouthwest(rbitscan(sw_blockers));
-        atk ^= getSoutheast(rbitscan(se_blockers));
+    Magic rookMagics[SQUARE_COUNT];
+    Magic bishopMagics[SQUARE_COUNT];
 
-        return atk;
-    }
-
-    Bitboard rook(int square, Bitboard occupancy)
-    {
-        Bitboard atk = rook(square);
-        Bitboard n_blockers = (getNorth(square) & occupancy) | getBit(H8);
-        Bitboard s_blockers = (getSouth(square) & occupancy) | getBit(A1);
-        Bitboard e_blockers = (getEast(square) & occupancy) | getBit(H8);
-        Bitboard w_blockers = (getWest(square) & occupancy) | getBit(A1);
-
-        atk ^= getNorth(fbitscan(n_blockers));
-        atk ^= getSouth(rbitscan(s_blockers));
-        atk ^= getEast(fbitscan(e_blockers));
-        atk ^= getWest(rbitscan(w_blockers));
-
-        return atk;
-    }
-
-    Bitboard queen(int square, Bitboard occupancy)
-    {
-        Bitboard atk = queen(square);
-        Bitboard nw_blockers = (getNorthwest(square) & occupancy) | getBit(A8);
-        Bitboard ne_blockers = (getNortheast(square) & occupancy) | getBit(H8);
-        Bitboard sw_blockers = (getSouthwest(square) & occupancy) | getBit(A1);
-        Bitboard se_blockers = (getSoutheast(square) & occupancy) | getBit(H1);
-        Bitboard n_blockers = (getNorth(square) & occupancy) | getBit(H8);
-        Bitboard s_blockers = (getSouth(square) & occupancy) | getBit(A1);
-        Bitboard w_blockers = (getWest(square) & occupancy) | getBit(A1);
-        Bitboard e_blockers = (getEast(square) & occupancy) | getBit(H8);
-
-        atk ^= getNorthwest(fbitscan(nw_blockers));
-        atk ^= getNortheast(fbitscan(ne_blockers));
-        atk ^= getSouthwest(rbitscan(sw_blockers));
-        atk ^= getSoutheast(rbitscan(se_blockers));
-        atk ^= getNorth(fbitscan(n_blockers));
-        atk ^= getSouth(rbitscan(s_blockers));
-        atk ^= getWest(rbitscan(w_blockers));
-        atk ^= getEast(fbitscan(e_blockers));
-
-        return atk;
-    }
-
-    Bitboard attacks(int piece_type, int square, Bitboard occupancy, int side) {
-        switch(piece_type) {
-        case PAWN: return pawn(square, side);
-        case KNIGHT: return knight(square);
-        case BISHOP: return bishop(square, occupancy);
-        case ROOK: return rook(square, occupancy);
-        case QUEEN: return queen(square, occupancy);
-        case KING: return king(square);
-        default: return -1;
-        }
-    }
+    void init() {
+        usePext = CPU::hasFastPext;
 
-    Bitboard getPassedPawnMask(int square) {
-        return passedPawnMask[square];
-        }
-    Bitboard getOutpostMask(Square square) {
-        return outpostMask[square];
-    }
-    Bitboard getKingDangerZone(Colour c, Square square) {
-        return relativeBoard(c, kingThreats[relativeSquare(c, square)]);
-    }
-    Bitboard kingShelter(Colour c, Square square) {
-        return kingShelters[square][c];
+        init_magics(rookTable, rookMagics, rook_rays);
+        init_magics(bishopTable, bishopMagics, bishop_rays);
     }
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <bitset>
 #include <string>
 #include "defines.h"
@@ -22,6 +23,8 @@ constexpr Bitboard FILE_F_MASK = uint64_t(0x2020202020202020);
 constexpr Bitboard FILE_G_MASK = uint64_t(0x4040404040404040);
 constexpr Bitboard FILE_H_MASK = uint64_t(0x8080808080808080);
 
+constexpr Bitboard DARK_SQUARES = uint64_t(0xAA55AA55AA55AA55);
+
 // From Stockfish
 constexpr Bitboard shift(Bitboard b, Direction D) {
 	return  D == NORTH ? b << 8 : D == SOUTH ? b >> 8
@@ -32,51 +35,395 @@ constexpr Bitboard shift(Bitboard b, Direction D) {
 		: 0;
 }
 
-// From Teki
+constexpr Bitboard getBit(int shift) {
+	return shift >= 0 && shift < 64 ? (Bitboard(1) << shift) : 0;
+}
+
+// Set by lookups::init on processors with a fast PEXT. It never changes afterwards, so
+// the test in Magic::index always goes the same way.
+inline bool usePext = false;
+
+// Like popCount, GCC and Clang get the instruction through inline assembly unless the
+// program is compiled for BMI2, so that it inlines into every slider lookup
+inline Bitboard pext(Bitboard b, Bitboard mask) {
+#if defined(__GNUC__) && !defined(__BMI2__)
+	Bitboard result;
+	__asm__("pextq %2, %1, %0" : "=r"(result) : "r"(b), "rm"(mask));
+	return result;
+#else
+	return _pext_u64(b, mask);
+#endif
+}
+
+// Fancy magic bitboards. Each square owns a slice of the shared attack table, indexed by
+// multiplying the relevant occupancy by the magic number, or by PEXT where it is available.
+struct Magic {
+	Bitboard mask;
+	Bitboard magic;
+	Bitboard* attacks;
+	unsigned shift;
+
+	unsigned index(Bitboard occupied) const {
+		if(usePext) {
+			return unsigned(pext(occupied, mask));
+		}
+
+		return unsigned(((occupied & mask) * magic) >> shift);
+	}
+};
+
+// From Teki. Everything except the magic tables is generated at compile time, so the
+// accessors below are plain array reads the compiler can inline into the hot paths.
 namespace lookups
 {
+	typedef std::array<Bitboard, SQUARE_COUNT> SquareTable;
+	typedef std::array<SquareTable, SQUARE_COUNT> PairTable;
+
 	extern void init();
 
-	extern int distance(int from, int to);
-	extern Bitboard ray(int from, int to);
-	extern Bitboard xray(int from, int to);
-	extern Bitboard full_ray(int from, int to);
-	extern Bitboard intervening_sqs(int from, int to);
-	extern Bitboard adjacent_files(int square);
-	extern Bitboard adjacent_sqs(int square);
-	extern Bitboard fileMask(int square);
-	extern Bitboard rankMask(int square);
-
-	extern Bitboard getNorth(int square);
-	extern Bitboard getSouth(int square);
-	extern Bitboard getEast(int square);
-	extern Bitboard getWest(int square);
-	extern Bitboard getNortheast(int square);
-	extern Bitboard getNorthwest(int square);
-	extern Bitboard getSoutheast(int square);
-	extern Bitboard getSouthwest(int square);
-	extern Bitboard getNorthRegion(int square);
-	extern Bitboard getSouthRegion(int square);
-	extern Bitboard getEastRegion(int square);
-	extern Bitboard getWestRegion(int square);
-
-	extern Bitboard pawn(int square, int side);
-	extern Bitboard knight(int square);
-	extern Bitboard bishop(int square);
-	extern Bitboard rook(int square);
-	extern Bitboard queen(int square);
-	extern Bitboard bishop(int square, Bitboard occupancy);
-	extern Bitboard rook(int square, Bitboard occupancy);
-	extern Bitboard queen(int square, Bitboard occupancy);
-	extern Bitboard king(int square);
-	extern Bitboard attacks(int piece_type, int square, Bitboard occupancy, int side = WHITE);
-
-	extern Bitboard getPassedPawnMask(int square);
-	extern Bitboard getOutpostMask(Square square);
-	extern Bitboard getKingDangerZone(Colour c, Square square);
-	extern Bitboard kingShelter(Colour c, Square square);
-}
+	extern Magic rookMagics[SQUARE_COUNT];
+	extern Magic bishopMagics[SQUARE_COUNT];
+
+	constexpr bool onBoard(int file, int rank) {
+		return file >= FILE_A && file <= FILE_H && rank >= RANK_1 && rank <= RANK_8;
+	}
+
+	constexpr Bitboard step(int square, int df, int dr) {
+		return onBoard(getFile(Square(square)) + df, getRank(Square(square)) + dr) ? getBit(square + df + 8 * dr) : 0;
+	}
+
+	constexpr SquareTable make_direction(int df, int dr) {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			int file = getFile(Square(square)) + df, rank = getRank(Square(square)) + dr;
+			for(; onBoard(file, rank); file += df, rank += dr) {
+				table[square] |= getBit(getSquare(file, rank));
+			}
+		}
+		return table;
+	}
+
+	inline constexpr SquareTable north = make_direction(0, 1);
+	inline constexpr SquareTable south = make_direction(0, -1);
+	inline constexpr SquareTable east = make_direction(1, 0);
+	inline constexpr SquareTable west = make_direction(-1, 0);
+	inline constexpr SquareTable northeast = make_direction(1, 1);
+	inline constexpr SquareTable northwest = make_direction(-1, 1);
+	inline constexpr SquareTable southeast = make_direction(1, -1);
+	inline constexpr SquareTable southwest = make_direction(-1, -1);
+
+	constexpr std::array<SquareTable, COLOUR_COUNT> make_pawn_attacks() {
+		std::array<SquareTable, COLOUR_COUNT> table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			table[WHITE][square] = step(square, -1, 1) | step(square, 1, 1);
+			table[BLACK][square] = step(square, -1, -1) | step(square, 1, -1);
+		}
+		return table;
+	}
+
+	constexpr SquareTable make_leaper(const int (&deltas)[8][2]) {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			for(const auto& delta : deltas) {
+				table[square] |= step(square, delta[0], delta[1]);
+			}
+		}
+		return table;
+	}
+
+	constexpr int knightDeltas[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+	constexpr int kingDeltas[8][2] = { {0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1} };
+
+	inline constexpr std::array<SquareTable, COLOUR_COUNT> attacksPawn = make_pawn_attacks();
+	inline constexpr SquareTable attacksKnight = make_leaper(knightDeltas);
+	inline constexpr SquareTable attacksKing = make_leaper(kingDeltas);
+
+	constexpr SquareTable make_pseudo_slider(bool diagonals, bool orthogonals) {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			if(diagonals) {
+				table[square] |= northeast[square] | northwest[square] | southeast[square] | southwest[square];
+			}
+			if(orthogonals) {
+				table[square] |= north[square] | south[square] | east[square] | west[square];
+			}
+		}
+		return table;
+	}
+
+	inline constexpr SquareTable attacksBishop = make_pseudo_slider(true, false);
+	inline constexpr SquareTable attacksRook = make_pseudo_slider(false, true);
+	inline constexpr SquareTable attacksQueen = make_pseudo_slider(true, true);
+
+	constexpr SquareTable make_file_masks() {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			table[square] = north[square] | south[square] | getBit(square);
+		}
+		return table;
+	}
+
+	constexpr SquareTable make_rank_masks() {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			table[square] = east[square] | west[square] | getBit(square);
+		}
+		return table;
+	}
+
+	inline constexpr SquareTable maskFile = make_file_masks();
+	inline constexpr SquareTable maskRank = make_rank_masks();
+
+	constexpr SquareTable make_adjacent_files() {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			if(getFile(Square(square)) != FILE_A) {
+				table[square] |= maskFile[square - 1];
+			}
+			if(getFile(Square(square)) != FILE_H) {
+				table[square] |= maskFile[square + 1];
+			}
+		}
+		return table;
+	}
+
+	constexpr SquareTable make_adjacent_squares() {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			table[square] = step(square, -1, 0) | step(square, 1, 0);
+		}
+		return table;
+	}
 
-inline Bitboard getBit(int shift) {
-	return shift < 64 ? (Bitboard(1) << shift) : 0;
-}
\ No newline at end of file
+	constexpr SquareTable make_passed_pawn_masks() {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			table[square] = north[square];
+			if(getFile(Square(square)) != FILE_A) {
+				table[square] |= north[square - 1];
+			}
+			if(getFile(Square(square)) != FILE_H) {
+				table[square] |= north[square + 1];
+			}
+		}
+		return table;
+	}
+
+	inline constexpr SquareTable adjacentFiles = make_adjacent_files();
+	inline constexpr SquareTable adjacentSquares = make_adjacent_squares();
+	inline constexpr SquareTable passedPawnMask = make_passed_pawn_masks();
+
+	constexpr SquareTable make_outpost_masks() {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			table[square] = passedPawnMask[square] & maskFile[square];
+		}
+		return table;
+	}
+
+	inline constexpr SquareTable outpostMask = make_outpost_masks();
+
+	constexpr std::array<std::array<int, SQUARE_COUNT>, SQUARE_COUNT> make_distances() {
+		std::array<std::array<int, SQUARE_COUNT>, SQUARE_COUNT> table {};
+		for(int i = A1; i < SQUARE_COUNT; ++i) {
+			for(int j = A1; j < SQUARE_COUNT; ++j) {
+				int ranks = getRank(Square(i)) - getRank(Square(j));
+				int files = getFile(Square(i)) - getFile(Square(j));
+				ranks = ranks < 0 ? -ranks : ranks;
+				files = files < 0 ? -files : files;
+				table[i][j] = ranks > files ? ranks : files;
+			}
+		}
+		return table;
+	}
+
+	inline constexpr std::array<std::array<int, SQUARE_COUNT>, SQUARE_COUNT> distanceVal = make_distances();
+
+	// Step between two squares on a common line, or 0 if they are not aligned
+	constexpr int line_step(int from, int to) {
+		int df = getFile(Square(to)) - getFile(Square(from));
+		int dr = getRank(Square(to)) - getRank(Square(from));
+
+		if(from == to || (df && dr && df != dr && df != -dr)) {
+			return 0;
+		}
+
+		return (df > 0) - (df < 0) + 8 * ((dr > 0) - (dr < 0));
+	}
+
+	// Every square from one end to the other, both included
+	constexpr PairTable make_rays() {
+		PairTable table {};
+		for(int i = A1; i < SQUARE_COUNT; ++i) {
+			for(int j = A1; j < SQUARE_COUNT; ++j) {
+				if(int d = line_step(i, j)) {
+					for(int s = i; s != j; s += d) {
+						table[i][j] |= getBit(s);
+					}
+					table[i][j] |= getBit(j);
+				}
+			}
+		}
+		return table;
+	}
+
+	// The squares strictly between the two
+	constexpr PairTable make_intervening() {
+		PairTable table {};
+		for(int i = A1; i < SQUARE_COUNT; ++i) {
+			for(int j = A1; j < SQUARE_COUNT; ++j) {
+				if(int d = line_step(i, j)) {
+					for(int s = i + d; s != j; s += d) {
+						table[i][j] |= getBit(s);
+					}
+				}
+			}
+		}
+		return table;
+	}
+
+	// The whole ray leaving the first square in the direction of the second
+	constexpr PairTable make_xrays() {
+		PairTable table {};
+		for(int i = A1; i < SQUARE_COUNT; ++i) {
+			for(int j = A1; j < SQUARE_COUNT; ++j) {
+				switch(line_step(i, j)) {
+				case NORTH: table[i][j] = north[i]; break;
+				case SOUTH: table[i][j] = south[i]; break;
+				case EAST: table[i][j] = east[i]; break;
+				case WEST: table[i][j] = west[i]; break;
+				case NORTH_EAST: table[i][j] = northeast[i]; break;
+				case NORTH_WEST: table[i][j] = northwest[i]; break;
+				case SOUTH_EAST: table[i][j] = southeast[i]; break;
+				case SOUTH_WEST: table[i][j] = southwest[i]; break;
+				default: break;
+				}
+			}
+		}
+		return table;
+	}
+
+	constexpr PairTable make_full_rays() {
+		PairTable table {};
+		for(int i = A1; i < SQUARE_COUNT; ++i) {
+			for(int j = A1; j < SQUARE_COUNT; ++j) {
+				int d = line_step(i, j);
+				if(d == NORTH || d == SOUTH || d == EAST || d == WEST) {
+					table[i][j] = (attacksRook[i] & attacksRook[j]) | getBit(i) | getBit(j);
+				}
+				else if(d) {
+					table[i][j] = (attacksBishop[i] & attacksBishop[j]) | getBit(i) | getBit(j);
+				}
+			}
+		}
+		return table;
+	}
+
+	inline constexpr PairTable attacksRay = make_rays();
+	inline constexpr PairTable attacksInterveningRay = make_intervening();
+	inline constexpr PairTable attacksXray = make_xrays();
+	inline constexpr PairTable attacksFullRay = make_full_rays();
+
+	constexpr std::array<SquareTable, 4> make_regions() {
+		std::array<SquareTable, 4> table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			for(int r = getRank(Square(square)) + 1; r <= RANK_8; ++r)
+				table[0][square] |= maskRank[getSquare(FILE_A, r)];
+			for(int r = getRank(Square(square)) - 1; r >= RANK_1; --r)
+				table[1][square] |= maskRank[getSquare(FILE_A, r)];
+			for(int f = getFile(Square(square)) + 1; f <= FILE_H; ++f)
+				table[2][square] |= maskFile[getSquare(f, RANK_1)];
+			for(int f = getFile(Square(square)) - 1; f >= FILE_A; --f)
+				table[3][square] |= maskFile[getSquare(f, RANK_1)];
+		}
+		return table;
+	}
+
+	inline constexpr std::array<SquareTable, 4> regions = make_regions();
+
+	constexpr SquareTable make_king_threats() {
+		SquareTable table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			table[square] = getBit(square) | attacksKing[square] | (attacksKing[square] >> 8);
+		}
+		return table;
+	}
+
+	constexpr std::array<SquareTable, COLOUR_COUNT> make_king_shelters() {
+		std::array<SquareTable, COLOUR_COUNT> table {};
+		for(int square = A1; square < SQUARE_COUNT; ++square) {
+			table[WHITE][square] = table[BLACK][square] = getBit(square) | attacksKing[square];
+			if(square < 8) {
+				table[WHITE][square] |= attacksKing[square + 8];
+			}
+			if(square > 55) {
+				table[BLACK][square] |= attacksKing[square - 8];
+			}
+		}
+		return table;
+	}
+
+	inline constexpr SquareTable kingThreats = make_king_threats();
+	inline constexpr std::array<SquareTable, COLOUR_COUNT> kingShelters = make_king_shelters();
+
+	inline int distance(int from, int to) { return distanceVal[from][to]; }
+	inline Bitboard ray(int from, int to) { return attacksRay[from][to]; }
+	inline Bitboard xray(int from, int to) { return attacksXray[from][to]; }
+	inline Bitboard full_ray(int from, int to) { return attacksFullRay[from][to]; }
+	inline Bitboard intervening_sqs(int from, int to) { return attacksInterveningRay[from][to]; }
+	inline Bitboard adjacent_files(int square) { return adjacentFiles[square]; }
+	inline Bitboard adjacent_sqs(int square) { return adjacentSquares[square]; }
+	inline Bitboard fileMask(int square) { return maskFile[square]; }
+	inline Bitboard rankMask(int square) { return maskRank[square]; }
+
+	inline Bitboard getNorth(int square) { return north[square]; }
+	inline Bitboard getSouth(int square) { return south[square]; }
+	inline Bitboard getEast(int square) { return east[square]; }
+	inline Bitboard getWest(int square) { return west[square]; }
+	inline Bitboard getNortheast(int square) { return northeast[square]; }
+	inline Bitboard getNorthwest(int square) { return northwest[square]; }
+	inline Bitboard getSoutheast(int square) { return southeast[square]; }
+	inline Bitboard getSouthwest(int square) { return southwest[square]; }
+	inline Bitboard getNorthRegion(int square) { return regions[0][square]; }
+	inline Bitboard getSouthRegion(int square) { return regions[1][square]; }
+	inline Bitboard getEastRegion(int square) { return regions[2][square]; }
+	inline Bitboard getWestRegion(int square) { return regions[3][square]; }
+
+	inline Bitboard pawn(int square, int side) { return attacksPawn[side][square]; }
+	inline Bitboard knight(int square) { return attacksKnight[square]; }
+	inline Bitboard bishop(int square) { return attacksBishop[square]; }
+	inline Bitboard rook(int square) { return attacksRook[square]; }
+	inline Bitboard queen(int square) { return attacksQueen[square]; }
+	inline Bitboard king(int square) { return attacksKing[square]; }
+
+	inline Bitboard bishop(int square, Bitboard occupancy) {
+		const Magic& m = bishopMagics[square];
+		return m.attacks[m.index(occupancy)];
+	}
+	inline Bitboard rook(int square, Bitboard occupancy) {
+		const Magic& m = rookMagics[square];
+		return m.attacks[m.index(occupancy)];
+	}
+	inline Bitboard queen(int square, Bitboard occupancy) {
+		return bishop(square, occupancy) | rook(square, occupancy);
+	}
+
+	inline Bitboard attacks(int piece_type, int square, Bitboard occupancy, int side = WHITE) {
+		switch(piece_type) {
+		case PAWN: return pawn(square, side);
+		case KNIGHT: return knight(square);
+		case BISHOP: return bishop(square, occupancy);
+		case ROOK: return rook(square, occupancy);
+		case QUEEN: return queen(square, occupancy);
+		case KING: return king(square);
+		default: return -1;
+		}
+	}
+
+	inline Bitboard getPassedPawnMask(int square) { return passedPawnMask[square]; }
+	inline Bitboard getOutpostMask(Square square) { return outpostMask[square]; }
+	inline Bitboard getKingDangerZone(Colour c, Square square) {
+		return relativeBoard(c, kingThreats[relativeSquare(c, square)]);
+	}
+	inline Bitboard kingShelter(Colour c, Square square) { return kingShelters[c][square]; }
+}
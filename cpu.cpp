@@ -0,0 +1,78 @@
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include "cpu.h"
+
+namespace {
+
+    const char* TierNames[CPU::TIER_COUNT] = { "scalar", "sse4.2", "avx2", "avx512" };
+
+    CPU::Tier currentTier = CPU::SCALAR;
+
+    void cpuid(int leaf, int subleaf, uint32_t registers[4]) {
+#if defined(_MSC_VER)
+        __cpuidex(reinterpret_cast<int*>(registers), leaf, subleaf);
+#else
+        __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+    }
+
+    // Which register states the OS saves on a context switch. The wide registers are
+    // of no use unless it saves them.
+    uint64_t enabledStates() {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (uint64_t(edx) << 32) | eax;
+#endif
+    }
+
+    bool bit(uint32_t value, int index) {
+        return (value >> index) & 1;
+    }
+}
+
+bool CPU::hasPopcnt = false;
+bool CPU::hasFastPext = false;
+
+void CPU::init() {
+    uint32_t leaf1[4] = { 0 }, leaf7[4] = { 0 };
+    uint32_t maxLeaf[4] = { 0 };
+
+    cpuid(0, 0, maxLeaf);
+    cpuid(1, 0, leaf1);
+    if(maxLeaf[0] >= 7) {
+        cpuid(7, 0, leaf7);
+    }
+
+    uint32_t ecx1 = leaf1[2], ebx7 = leaf7[1];
+    uint32_t baseFamily = (leaf1[0] >> 8) & 0xF;
+    uint32_t family = baseFamily == 0xF ? baseFamily + ((leaf1[0] >> 20) & 0xFF) : baseFamily;
+
+    // The vendor string starts "Auth" for AMD and "Hygo" for Hygon, whose processors are Zen 1
+    bool amd = maxLeaf[1] == 0x68747541 || maxLeaf[1] == 0x6F677948;
+    uint64_t states = bit(ecx1, 27) ? enabledStates() : 0;
+
+    bool sse42 = bit(ecx1, 19) && bit(ecx1, 20) && bit(ecx1, 23);
+    bool avx2 = sse42 && (states & 0x6) == 0x6 && bit(ecx1, 28) && bit(ebx7, 5) && bit(ebx7, 8);
+    bool avx512 = avx2 && (states & 0xE6) == 0xE6 && bit(ebx7, 16) && bit(ebx7, 30);
+
+    hasPopcnt = bit(ecx1, 23);
+    hasFastPext = bit(ebx7, 8) && (!amd || family >= 0x19);
+    currentTier = avx512 ? AVX512 : avx2 ? AVX2 : sse42 ? SSE42 : SCALAR;
+}
+
+CPU::Tier CPU::tier() {
+    return currentTier;
+}
+
+const char* CPU::name() {
+    return TierNames[currentTier];
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Instruction set tiers, picked once at startup from what the processor and the OS
+// support. The bit tricks, slider attacks and network kernels all choose their
+// implementation from this, so one binary runs at full speed on any x86-64 machine.
+namespace CPU {
+
+    enum Tier {
+        SCALAR,
+        SSE42,  // SSE4.2 and POPCNT
+        AVX2,   // AVX2 and BMI2
+        AVX512, // AVX-512 F and BW
+        TIER_COUNT
+    };
+
+    void init();
+    Tier tier();
+    const char* name();
+
+    // Read by popCount unless the whole program is compiled for the instruction
+    extern bool hasPopcnt;
+
+    // BMI2 in hardware. AMD processors before Zen 3 run PEXT in microcode, far slower
+    // than the magic multiplication, so the slider attacks do not use it there.
+    extern bool hasFastPext;
+}
+
+// Lets a function use instructions beyond what the whole program is compiled for.
+// MSVC allows any intrinsic anywhere, so it needs no attribute.
+#if defined(__GNUC__)
+#define TARGET(features) __attribute__((target(features)))
+#else
+#define TARGET(features)
+#endif
@@ -10,7 +10,10 @@
 #include <mutex>
 #include <string>
 #include "immintrin.h"
+#if defined(_MSC_VER)
 #include "intrin.h"
+#endif
+#include "cpu.h"
 #include "utils.h"
 
 typedef uint64_t Bitboard;
@@ -22,6 +25,7 @@ typedef std::mutex Mutex;
 #undef INFINITY
 constexpr int MAX_MOVES = 256;
 constexpr int MAX_PLY = 128;
+constexpr int MAX_GAME_PLY = 1024;
 constexpr int MAX_HEIGHT = 128;
 constexpr int MAX_THREADS = 64;
 constexpr int MAX_HISTORY_DEPTH = 12;
@@ -57,7 +61,7 @@ enum PromotionType : int {
 	PROMOTION_MASK		= 3 << 12,
 };
 
-enum Piece : int {
+enum Piece : uint8_t {
 	NO_PIECE = 0,
 	wP = 1, wN, wB, wR, wQ, wK,
 	bP = 9, bN, bB, bR, bQ, bK,
@@ -67,7 +71,7 @@ enum Piece : int {
 enum PieceType : int {
 	NO_PIECE_TYPE, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING,
 	PIECE_TYPE_COUNT = 7,
-	ALL_PIECES = 6,
+	ALL_PIECES = 0,
 };
 
 const std::string PieceName[15] = { ". ", "wP", "wN", "wB", "wR", "wQ", "wK", "", "", "bP", "bN", "bB", "bR", "bQ", "bK" };
@@ -139,6 +143,12 @@ enum Phase : int {
 	MG = 0, EG = 1, PHASE_NB = 2
 };
 
+enum ScaleFactor : int {
+	SCALE_FACTOR_DRAW = 0,
+	SCALE_FACTOR_NORMAL = 64,
+	SCALE_FACTOR_NONE = 255
+};
+
 enum Bound : int {
 	BOUND_NONE,
 	BOUND_UPPER,
@@ -214,15 +224,15 @@ ENABLE_FULL_OPERATORS_ON(Value)
 #undef ENABLE_FULL_OPERATORS_ON
 #undef ENABLE_BASE_OPERATORS_ON
 
-inline int getSquare(int file, int rank) { return (rank << 3) ^ file; }
-inline Rank getRank(Square square) { return Rank(square >> 3); }
+constexpr int getSquare(int file, int rank) { return (rank << 3) ^ file; }
+constexpr Rank getRank(Square square) { return Rank(square >> 3); }
 inline Rank relativeRank(Colour colour, Square square) {
 	return Rank((square >> 3) ^ (colour * 7));
 }
 inline Rank relativeRank(Colour c, Rank r) {
 	return Rank(r ^ (c * 7));
 }
-inline File getFile(Square square) { return File(square & 7); }
+constexpr File getFile(Square square) { return File(square & 7); }
 inline Rank getRelativeFile(Colour colour, Square square) { return Rank((square >> 3) ^ (colour * 7)); }
 inline int edgeDistance(File f) {
 	return std::min(f, File(FILE_H - f));
@@ -259,14 +269,47 @@ inline Move fromAndTo(Square from, Square to) {
 	return Move(to | (from << 6));
 }
 
+// Unless the whole program is compiled for POPCNT, popCount checks the processor at
+// runtime. GCC and Clang would otherwise call a library routine for every count, so
+// they get the instruction through inline assembly, which needs no target attribute
+// and inlines anywhere. The bit scans are always single instructions. An empty board
+// gives NO_SQUARE from fbitscan and -1 from rbitscan.
 inline int popCount(Bitboard bb) {
-	return _mm_popcnt_u64(bb);
+#if defined(__GNUC__) && defined(__POPCNT__)
+	return __builtin_popcountll(bb);
+#elif defined(__GNUC__)
+	if(CPU::hasPopcnt) {
+		Bitboard count;
+		__asm__("popcntq %1, %0" : "=r"(count) : "rm"(bb));
+		return int(count);
+	}
+
+	return __builtin_popcountll(bb);
+#else
+	if(CPU::hasPopcnt) {
+		return int(__popcnt64(bb));
+	}
+
+	bb = bb - ((bb >> 1) & 0x5555555555555555);
+	bb = (bb & 0x3333333333333333) + ((bb >> 2) & 0x3333333333333333);
+	return int((((bb + (bb >> 4)) & 0x0F0F0F0F0F0F0F0F) * 0x0101010101010101) >> 56);
+#endif
 }
 inline Square fbitscan(Bitboard bb) { //lsb
-	return Square(_tzcnt_u64(bb));
+#if defined(__GNUC__)
+	return bb ? Square(__builtin_ctzll(bb)) : NO_SQUARE;
+#else
+	unsigned long index;
+	return _BitScanForward64(&index, bb) ? Square(index) : NO_SQUARE;
+#endif
 }
 inline Square rbitscan(Bitboard bb) { //msb
-	return Square(63 - _lzcnt_u64(bb));
+#if defined(__GNUC__)
+	return Square(bb ? 63 ^ __builtin_clzll(bb) : -1);
+#else
+	unsigned long index;
+	return Square(_BitScanReverse64(&index, bb) ? int(index) : -1);
+#endif
 }
 
 inline Square relativeFirstBit(Colour c, Bitboard bb) {
@@ -287,4 +330,54 @@ inline Square popLsb(Bitboard& bitboard) {
 	return Square(s);
 }
 
-inline Bitboard bitShift(int shift) { return shift < 64 ? uint64_t(1) << shift : 0; }
\ No newline at end of file
+inline Bitboard bitShift(int shift) { return shift < 64 ? uint64_t(1) << shift : 0; }
+
+// A middlegame and an endgame value packed into one integer, the middlegame value in
+// the upper half. Adding, subtracting and scaling by an integer act on both halves at
+// once, so the evaluation sums scores with single integer instructions.
+struct Score {
+public:
+	constexpr Score() : packed(0) {}
+	constexpr Score(int val) : Score(val, val) {}
+	constexpr Score(int mg, int eg) : packed(int32_t(uint32_t(mg) << 16) + eg) {}
+
+	constexpr Value value(int phase, int max_phase) const { return Value((mg() * (max_phase - phase) + eg() * phase) / max_phase); }
+	constexpr Value value() const { return mg(); }
+
+	constexpr Score operator-() const { return fromPacked(-packed); }
+
+	constexpr Score operator+(const Score& rhs) const { return fromPacked(packed + rhs.packed); }
+	constexpr Score operator-(const Score& rhs) const { return fromPacked(packed - rhs.packed); }
+	constexpr Score operator*(const Score& rhs) const { return Score(int(mg()) * rhs.mg(), int(eg()) * rhs.eg()); }
+	constexpr Score operator/(const Score& rhs) const { return Score(int(mg()) / rhs.mg(), int(eg()) / rhs.eg()); }
+
+	constexpr Score operator+(const int rhs) const { return *this + Score(rhs); }
+	constexpr Score operator-(const int rhs) const { return *this - Score(rhs); }
+	constexpr Score operator*(const int rhs) const { return fromPacked(packed * rhs); }
+	constexpr Score operator/(const int rhs) const { return Score(mg() / rhs, eg() / rhs); }
+
+	Score& operator+=(const Score& rhs) { return *this = *this + rhs; }
+	Score& operator-=(const Score& rhs) { return *this = *this - rhs; }
+	Score& operator*=(const Score& rhs) { return *this = *this * rhs; }
+	Score& operator/=(const Score& rhs) { return *this = *this / rhs; }
+
+	Score& operator+=(const int rhs) { return *this = *this + rhs; }
+	Score& operator-=(const int rhs) { return *this = *this - rhs; }
+	Score& operator*=(const int rhs) { return *this = *this * rhs; }
+	Score& operator/=(const int rhs) { return *this = *this / rhs; }
+
+private:
+	static constexpr Score fromPacked(int32_t value) { Score score; score.packed = value; return score; }
+
+	// The endgame half is read as signed, so a negative one borrows from the middlegame
+	// half and is rounded back here
+	constexpr Value mg() const { return Value(int16_t(uint16_t(uint32_t(packed + 0x8000) >> 16))); }
+	constexpr Value eg() const { return Value(int16_t(uint16_t(uint32_t(packed)))); }
+
+	int32_t packed;
+};
+
+static_assert(sizeof(Score) == 4, "Score must pack into 32 bits");
+
+constexpr Score S(Value val) { return Score(val); }
+constexpr Score S(int mg, int eg) { return Score(mg, eg); }
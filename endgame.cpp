@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <unordered_map>
+
+#include "bitboard.h"
+#include "endgame.h"
+#include "material.h"
+#include "movegen.h"
+
+// Evaluation functions for endgames where the general evaluation does poorly, mostly
+// from Stockfish. Each one is looked up by the material key of its material
+// distribution, once for either colour as the strong side.
+
+namespace {
+
+    // Drives the losing king towards the edge in KX vs K and KQ vs KR
+    constexpr int PushToEdges[SQUARE_COUNT] = {
+        100, 90, 80, 70, 70, 80, 90, 100,
+         90, 70, 60, 50, 50, 60, 70,  90,
+         80, 60, 40, 30, 30, 40, 60,  80,
+         70, 50, 30, 20, 20, 30, 50,  70,
+         70, 50, 30, 20, 20, 30, 50,  70,
+         80, 60, 40, 30, 30, 40, 60,  80,
+         90, 70, 60, 50, 50, 60, 70,  90,
+        100, 90, 80, 70, 70, 80, 90, 100
+    };
+
+    // Drives the losing king towards A1 or H8 in KBN vs K
+    constexpr int PushToCorners[SQUARE_COUNT] = {
+        200, 190, 180, 170, 160, 150, 140, 130,
+        190, 180, 170, 160, 150, 140, 130, 140,
+        180, 170, 155, 140, 140, 125, 140, 150,
+        170, 160, 140, 120, 110, 140, 150, 160,
+        160, 150, 140, 110, 120, 140, 160, 170,
+        150, 140, 125, 140, 140, 155, 170, 180,
+        140, 130, 140, 150, 160, 170, 180, 190,
+        130, 140, 150, 160, 170, 180, 190, 200
+    };
+
+    // Indexed by the distance between two pieces
+    constexpr int PushClose[8] = { 0, 0, 100, 80, 60, 40, 20, 10 };
+    constexpr int PushAway[8] = { 0, 5, 20, 40, 60, 80, 90, 100 };
+
+    std::unordered_map<Key, Endgames::Endgame> endgames;
+
+    Value relative(const Position& position, Colour strongSide, Value value) {
+        return strongSide == position.getSide() ? value : -value;
+    }
+
+    // Maps a square as if the strong side were white with its only pawn on files A-D
+    Square normalize(const Position& position, Colour strongSide, Square square) {
+        if(getFile(position.getPosition(PAWN, strongSide)) >= FILE_E) {
+            square = Square(square ^ 7);
+        }
+
+        return relativeSquare(strongSide, square);
+    }
+
+    // Material key of a code like "KBNK", the strong side's pieces first
+    Key materialKey(const std::string& code, Colour strongSide) {
+        const std::string pieceChars = " PNBRQK";
+        size_t split = code.find('K', 1);
+        int counts[PIECE_COUNT] = { 0 };
+        Key key = 0;
+
+        for(size_t i = 0; i < code.size(); ++i) {
+            Colour colour = i < split ? strongSide : ~strongSide;
+            Piece piece = Piece(pieceChars.find(code[i]) + (colour == BLACK ? 8 : 0));
+
+            key ^= Zobrist::psq[piece][counts[piece]++];
+        }
+
+        return key;
+    }
+
+    void add(const std::string& code, Endgames::EvalFunction evaluate) {
+        for(Colour colour : { WHITE, BLACK }) {
+            endgames[materialKey(code, colour)] = { evaluate, colour };
+        }
+    }
+
+    // Same as KX vs K, but the king has to be driven into a corner the bishop covers
+    Value evaluateKBNK(const Position& position, Colour strongSide) {
+        Colour weakSide = ~strongSide;
+        Square winnerKing = position.getPosition(KING, strongSide);
+        Square loserKing = position.getPosition(KING, weakSide);
+
+        // PushToCorners leads to A1 and H8, so flip the kings for a light squared bishop
+        if(!(position.getBitboard(BISHOP, strongSide) & DARK_SQUARES)) {
+            winnerKing = relativeSquare(BLACK, winnerKing);
+            loserKing = relativeSquare(BLACK, loserKing);
+        }
+
+        Value result = VALUE_KNOWN_WIN
+            + PushClose[lookups::distance(winnerKing, loserKing)]
+            + PushToCorners[loserKing];
+
+        return relative(position, strongSide, result);
+    }
+
+    Value evaluateKPK(const Position& position, Colour strongSide) {
+        Square whiteKing = normalize(position, strongSide, position.getPosition(KING, strongSide));
+        Square blackKing = normalize(position, strongSide, position.getPosition(KING, ~strongSide));
+        Square pawn = normalize(position, strongSide, position.getPosition(PAWN, strongSide));
+
+        Colour us = strongSide == position.getSide() ? WHITE : BLACK;
+
+        if(!Bitbases::probe(whiteKing, pawn, blackKing, us)) {
+            return VALUE_DRAW;
+        }
+
+        Value result = VALUE_KNOWN_WIN + valuePawnEg + Value(getRank(pawn));
+
+        return relative(position, strongSide, result);
+    }
+
+    // A win unless the pawn is far advanced with its king next to it and the strong
+    // king far away
+    Value evaluateKRKP(const Position& position, Colour strongSide) {
+        Colour weakSide = ~strongSide;
+        Square winnerKing = relativeSquare(strongSide, position.getPosition(KING, strongSide));
+        Square loserKing = relativeSquare(strongSide, position.getPosition(KING, weakSide));
+        Square rook = relativeSquare(strongSide, position.getPosition(ROOK, strongSide));
+        Square pawn = relativeSquare(strongSide, position.getPosition(PAWN, weakSide));
+
+        Square queeningSquare = makeSquare(getFile(pawn), RANK_1);
+        Value result;
+
+        // The strong king stands in front of the pawn
+        if(lookups::getNorth(winnerKing) & bitShift(pawn)) {
+            result = valueRookEg - lookups::distance(winnerKing, pawn);
+        }
+        // The weak king is too far from both the pawn and the rook
+        else if(lookups::distance(loserKing, pawn) >= 3 + (position.getSide() == weakSide)
+            && lookups::distance(loserKing, rook) >= 3) {
+            result = valueRookEg - lookups::distance(winnerKing, pawn);
+        }
+        else if(getRank(loserKing) <= RANK_3
+            && lookups::distance(loserKing, pawn) == 1
+            && getRank(winnerKing) >= RANK_4
+            && lookups::distance(winnerKing, pawn) > 2 + (position.getSide() == strongSide)) {
+            result = Value(80 - 8 * lookups::distance(winnerKing, pawn));
+        }
+        else {
+            result = Value(200 - 8 * (lookups::distance(winnerKing, pawn + SOUTH)
+                - lookups::distance(loserKing, pawn + SOUTH)
+                - lookups::distance(pawn, queeningSquare)));
+        }
+
+        return relative(position, strongSide, result);
+    }
+
+    // Drawish, a little better when the weak king is near the edge
+    Value evaluateKRKB(const Position& position, Colour strongSide) {
+        Value result = Value(PushToEdges[position.getPosition(KING, ~strongSide)]);
+
+        return relative(position, strongSide, result);
+    }
+
+    // Like KR vs KB, but better still when the knight is far from its king
+    Value evaluateKRKN(const Position& position, Colour strongSide) {
+        Square loserKing = position.getPosition(KING, ~strongSide);
+        Square knight = position.getPosition(KNIGHT, ~strongSide);
+        Value result = Value(PushToEdges[loserKing] + PushAway[lookups::distance(loserKing, knight)]);
+
+        return relative(position, strongSide, result);
+    }
+
+    // A win, except for a pawn on the seventh rank of the A, C, F or H file with its
+    // king next to it
+    Value evaluateKQKP(const Position& position, Colour strongSide) {
+        Colour weakSide = ~strongSide;
+        Square winnerKing = position.getPosition(KING, strongSide);
+        Square loserKing = position.getPosition(KING, weakSide);
+        Square pawn = position.getPosition(PAWN, weakSide);
+
+        Value result = Value(PushClose[lookups::distance(winnerKing, loserKing)]);
+
+        if(relativeRank(weakSide, pawn) != RANK_7
+            || lookups::distance(loserKing, pawn) != 1
+            || !((FILE_A_MASK | FILE_C_MASK | FILE_F_MASK | FILE_H_MASK) & bitShift(pawn))) {
+            result += valueQueenEg - valuePawnEg;
+        }
+
+        return relative(position, strongSide, result);
+    }
+
+    Value evaluateKQKR(const Position& position, Colour strongSide) {
+        Square winnerKing = position.getPosition(KING, strongSide);
+        Square loserKing = position.getPosition(KING, ~strongSide);
+
+        Value result = Value(valueQueenEg - valueRookEg
+            + PushToEdges[loserKing]
+            + PushClose[lookups::distance(winnerKing, loserKing)]);
+
+        return relative(position, strongSide, result);
+    }
+
+    Value evaluateKNNK(const Position&, Colour) {
+        return VALUE_DRAW;
+    }
+}
+
+void Endgames::init() {
+    add("KBNK", evaluateKBNK);
+    add("KPK", evaluateKPK);
+    add("KRKP", evaluateKRKP);
+    add("KRKB", evaluateKRKB);
+    add("KRKN", evaluateKRKN);
+    add("KQKP", evaluateKQKP);
+    add("KQKR", evaluateKQKR);
+    add("KNNK", evaluateKNNK);
+}
+
+const Endgames::Endgame* Endgames::probe(Key materialKey) {
+    auto it = endgames.find(materialKey);
+
+    return it == endgames.end() ? nullptr : &it->second;
+}
+
+// Gives the strong side a bonus for pushing the lone king to the edge and for keeping
+// the kings close, which is enough to find the mate with anything but a lone minor
+Value Endgames::evaluateKXK(const Position& position, Colour strongSide) {
+    Colour weakSide = ~strongSide;
+
+    // Stalemate is the only way out for the lone king
+    if(position.getSide() == weakSide) {
+        ExtMove moveList[MAX_MOVES];
+
+        if(!generateLegalMoves(position, moveList)) {
+            return VALUE_DRAW;
+        }
+    }
+
+    Square winnerKing = position.getPosition(KING, strongSide);
+    Square loserKing = position.getPosition(KING, weakSide);
+    Bitboard bishops = position.getBitboard(BISHOP);
+
+    Value result = Value(Material::nonPawnMaterial(position, strongSide)
+        + popCount(position.getBitboard(PAWN, strongSide)) * valuePawnEg
+        + PushToEdges[loserKing]
+        + PushClose[lookups::distance(winnerKing, loserKing)]);
+
+    if(position.getBitboard(QUEEN)
+        || position.getBitboard(ROOK)
+        || (bishops && position.getBitboard(KNIGHT))
+        || ((bishops & ~DARK_SQUARES) && (bishops & DARK_SQUARES))) {
+        result = std::min(result + VALUE_KNOWN_WIN, VALUE_MATE_IN_MAX_PLY - 1);
+    }
+
+    return relative(position, strongSide, result);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+#include "defines.h"
+#include "position.h"
+
+namespace Bitbases {
+
+    void init();
+    bool probe(Square whiteKing, Square whitePawn, Square blackKing, Colour us);
+}
+
+namespace Endgames {
+
+    // Scores a known endgame from the point of view of the side to move
+    typedef Value (*EvalFunction)(const Position& position, Colour strongSide);
+
+    struct Endgame {
+        EvalFunction evaluate;
+        Colour strongSide;
+    };
+
+    void init();
+    const Endgame* probe(Key materialKey);
+
+    // King and enough material against a lone king, which is recognised by the
+    // material table rather than by key
+    Value evaluateKXK(const Position& position, Colour strongSide);
+}
@@ -2,249 +2,301 @@
 
 #include "bitboard.h"
 #include "evaluate.h"
+#include "material.h"
 #include "movegen.h"
+#include "nnue.h"
+#include "pawns.h"
 #include "search.h"
+#include "thread.h"
+#include "tt.h"
+#include "tune.h"
 
-int Evaluator::evaluate(Position& position) {
-    return Evaluate(position).value();
+Score PSQT::psq[PIECE_COUNT][SQUARE_COUNT];
+
+int Evaluator::evaluate(Position& position, Value alpha, Value beta) {
+    bool lazy;
+
+    return evaluate(position, alpha, beta, lazy);
 }
 
-Value Evaluate::value() {
-    Score score;
+int Evaluator::evaluate(Position& position, Value alpha, Value beta, bool& lazy) {
+    Key key = position.getPositionKey();
+    Value value;
+    bool found = EvalHash.probe(key, value);
+    Thread* thread = position.getThread();
 
-    Colour us = position.getSide();
-    Colour them = ~us;
+    ++thread->evalProbes;
+    thread->evalHits += found;
 
-    score += pawnScore(us) - pawnScore(them);
-    score += pieceScore(us) - pieceScore(them);
-    score += kingScore(us) - kingScore(them);
-    score += passedPawnScore(us) - passedPawnScore(them);
-    score += threatScore(us) - passedPawnScore(them);
+    lazy = false;
+
+    if(!found) {
+        Evaluate<false> evaluate(position, alpha, beta);
+        value = evaluate.value();
+        lazy = evaluate.lazyExit();
 
-    int phase = getGamePhase();
+        // A lazy value is only good enough for the window it was asked for
+        if(!lazy) {
+            EvalHash.save(key, value);
+        }
+    }
 
-    return score.value(phase, 256);
+    return value;
 }
 
-Score Evaluate::pawnScore(Colour colour) {
+template<bool Tracing>
+Value Evaluate<Tracing>::value() {
     Score score;
 
-    Colour us = colour;
+    Colour us = position.getSide();
     Colour them = ~us;
 
-    Bitboard ourPawns = position.getBitboard(PAWN, us);
-    Bitboard enemyPawns = position.getBitboard(PAWN, them);
+    material = Material::probe(position);
 
-    Direction relativeNorth = us == WHITE ? NORTH : SOUTH;
-    Direction relativeSouth = us == WHITE ? SOUTH : NORTH;
-    Direction relativeNorthEast = us == WHITE ? NORTH_EAST : SOUTH_EAST;
-    Direction relativeNorthWest = us == WHITE ? NORTH_WEST : SOUTH_WEST;
+    if(material->specializedEval()) {
+        return material->evaluate(position);
+    }
 
-    this->blockedPawns[us] = shift((shift(ourPawns, relativeNorth) & enemyPawns), relativeSouth);
-    Bitboard underAttack = shift(ourPawns, relativeNorthEast) | shift(ourPawns, relativeNorthWest);
+    // Known endgames above are exact, anything else goes to the network when one is used
+    if(!Tracing && NNUE::enabled()) {
+        return NNUE::evaluate(position);
+    }
 
-    this->attackedByMore[us] |= this->attackedBy[us][ALL_PIECES] & underAttack;
-    this->attackedBy[us][PAWN] |= underAttack;
-    this->attackedBy[us][ALL_PIECES] |= underAttack;
+    pawns = Pawns::probe(position, trace);
 
-    score += pieceValue[PAWN] * popCount(ourPawns);
+    attackMaps(WHITE);
+    attackMaps(BLACK);
 
-    Bitboard pawnOptions = ourPawns;
+    score += us == WHITE ? position.getPsqScore() : -position.getPsqScore();
+    score += pawnScore(us) - pawnScore(them);
+    score += pieceScore(us) - pieceScore(them);
+    score += us == WHITE ? material->imbalanceScore() : -material->imbalanceScore();
 
-    while(pawnOptions) {
-        Square pawn = popLsb(pawnOptions);
+    // The board and material terms are kept up to date elsewhere, so they are traced
+    // from the pieces themselves
+    if constexpr(Tracing) {
+        Bitboard pieces = position.getOccupied();
 
-        score += pieceSquareBonus[PAWN][relativeSquare(us, pawn)];
+        while(pieces) {
+            Square square = popLsb(pieces);
+            Piece piece = position.getPieceOnSquare(square);
+            Colour colour = position.getPieceColour(piece);
 
-        if(relativeBoard(us, lookups::getNorth(relativeSquare(us, pawn))) & ourPawns) {
-            score += doubledPawn;
+            term(pieceSquareBonus[getPieceType(piece)][relativeSquare(colour, square)], colour);
         }
-        else if(!(relativeBoard(us, lookups::getPassedPawnMask(relativeSquare(us, pawn))) & enemyPawns)) {
-            this->passedPawns[us] ^= bitShift(pawn);
+        for(Colour colour : { WHITE, BLACK }) {
+            if(popCount(position.getBitboard(BISHOP, colour)) >= 2) {
+                term(bishopPair, colour);
+            }
         }
+    }
 
-        if(!(lookups::adjacent_files(pawn) & ourPawns)) {
-            score += isolatedPawn;
-        }
-       
+    // The remaining terms rarely swing the score by more than the margin, so there
+    // is no need to work them out when the result is clear already
+    Value bound = scaledValue(score);
+
+    if(bound - LazyMargin >= beta || bound + LazyMargin <= alpha) {
+        lazy = true;
+        return bound;
     }
 
-    return score;
+    score += kingScore(us) - kingScore(them);
+    score += passedPawnScore(us) - passedPawnScore(them);
+    score += threatScore(us) - threatScore(them);
+
+    if constexpr(Tracing) {
+        trace->score = us == WHITE ? score : -score;
+        trace->phase = material->gamePhase();
+        trace->scale[WHITE] = material->scaleFactor(WHITE);
+        trace->scale[BLACK] = material->scaleFactor(BLACK);
+    }
+
+    return scaledValue(score);
 }
 
-Score Evaluate::pieceScore(Colour colour) {
-    Score score;
+template<bool Tracing>
+const Score& Evaluate<Tracing>::term(const Score& weight, Colour colour, double count) {
+    if constexpr(Tracing) {
+        trace->add(weight, colour, count);
+    }
+
+    return weight;
+}
+
+// Only the endgame part is scaled, by the factor of the side that is ahead there
+template<bool Tracing>
+Value Evaluate<Tracing>::scaledValue(Score score) const {
+    Colour us = position.getSide();
+    int phase = material->gamePhase();
+    Value mg = score.value(0, 1);
+    Value eg = score.value(1, 1);
+    ScaleFactor scaleFactor = material->scaleFactor(eg > VALUE_ZERO ? us : ~us);
+
+    return Value((mg * (256 - phase) + eg * scaleFactor * phase / SCALE_FACTOR_NORMAL) / 256);
+}
+
+void PSQT::init() {
+    for(PieceType pieceType = PAWN; pieceType <= KING; ++pieceType) {
+        for(Square square = A1; square <= H8; ++square) {
+            Score score = pieceValue[pieceType] + pieceSquareBonus[pieceType][square];
 
+            psq[pieceType][square] = score;
+            psq[pieceType + 8][relativeSquare(BLACK, square)] = -score;
+        }
+    }
+}
+
+// Fills in every attack map of one side before any term is scored, so the terms only
+// read the maps and do not depend on the order they are called in
+template<bool Tracing>
+void Evaluate<Tracing>::attackMaps(Colour colour) {
     Colour us = colour;
     Colour them = ~us;
 
     Bitboard occupied = position.getOccupied();
+    Bitboard pawnAttacks = pawns->pawnAttacks(us);
+    Bitboard kingAttacks = lookups::king(position.getPosition(KING, us));
+
+    this->blockedPawns[us] = pawns->blockedPawns(us);
+    this->passedPawns[us] = pawns->passedPawns(us);
+    this->mobility[us] = ~(pawns->pawnAttacks(them) | this->blockedPawns[us] | position.getBitboard(KING, us));
+
+    this->attackedBy[us][PAWN] = pawnAttacks;
+    this->attackedBy[us][KING] = kingAttacks;
+    this->attackedBy[us][ALL_PIECES] = pawnAttacks | kingAttacks;
+    this->attackedByMore[us] = pawnAttacks & kingAttacks;
+
+    for(PieceType pieceType = KNIGHT; pieceType <= QUEEN; ++pieceType) {
+        Bitboard pieces = position.getBitboard(pieceType, us);
+
+        while(pieces) {
+            Square pieceSquare = popLsb(pieces);
+            Bitboard attacks = lookups::attacks(pieceType, pieceSquare, occupied, us);
+
+            this->attacksFrom[pieceSquare] = attacks;
+            this->attackedByMore[us] |= this->attackedBy[us][ALL_PIECES] & attacks;
+            this->attackedBy[us][pieceType] |= attacks;
+            this->attackedBy[us][ALL_PIECES] |= attacks;
+        }
+    }
+}
 
-    Direction relativeSouthEast = us == WHITE ? SOUTH_EAST : NORTH_EAST;
-    Direction relativeSouthWest = us == WHITE ? SOUTH_WEST : NORTH_WEST;
+// The pawn terms come from the pawn hash
+template<bool Tracing>
+Score Evaluate<Tracing>::pawnScore(Colour colour) {
+    return pawns->pawnScore(colour);
+}
 
-    this->mobility[us] |= shift(position.getBitboard(PAWN, them), relativeSouthEast);
-    this->mobility[us] |= shift(position.getBitboard(PAWN, them), relativeSouthWest);
-    this->mobility[us] |= this->blockedPawns[us] | position.getBitboard(KING, us);
-    this->mobility[us] = ~mobility[us];
+template<bool Tracing>
+Score Evaluate<Tracing>::pieceScore(Colour colour) {
+    Score score;
 
-    score += knightScore(us);
-    score += bishopScore(us);
-    score += rookScore(us);
-    score += queenScore(us);
+    score += knightScore(colour);
+    score += bishopScore(colour);
+    score += rookScore(colour);
+    score += queenScore(colour);
 
     return score;
 }
 
-Score Evaluate::knightScore(Colour colour) {
+template<bool Tracing>
+Score Evaluate<Tracing>::knightScore(Colour colour) {
     Score score;
 
     Colour us = colour;
     Colour them = ~us;
 
-    Bitboard occupied = position.getOccupied();
     Bitboard knights = position.getBitboard(KNIGHT, us);
 
-    score += pieceValue[KNIGHT] * popCount(knights);
-
     while(knights) {
         Square pieceSquare = popLsb(knights);
 
-        Bitboard attacksOnEnemyKing = lookups::getKingDangerZone(us, position.getPosition(KING, them));
-        Bitboard attacks = lookups::attacks(KNIGHT, pieceSquare, occupied, us);
+        Bitboard attacks = this->attacksFrom[pieceSquare];
 
-        this->attackedByMore[us] |= this->attackedBy[us][ALL_PIECES] & attacks;
-        this->attackedBy[us][KNIGHT] |= attacks;
-        this->attackedBy[us][ALL_PIECES] |= attacks;
-
-        score += pieceSquareBonus[KNIGHT][relativeSquare(us, pieceSquare)];
-        score += mobilityBonus[KNIGHT][popCount(attacks & mobility[us])];
+        score += term(mobilityBonus[KNIGHT][popCount(attacks & mobility[us])], us);
         if(getPieceType(position.getPieceOnSquare(pieceSquare + pawnPush(us))) == PAWN) {
-            score += minorBehindPawn;
+            score += term(minorBehindPawn, us);
         }
         if(relativeBoard(us, lookups::getOutpostMask(relativeSquare(us, pieceSquare)))
         && !(relativeBoard(us, lookups::getOutpostMask(relativeSquare(us, pieceSquare))) & position.getBitboard(PAWN, them))) {
-            score += knightOutpost;
-        }
-
-        if(attacksOnEnemyKing) {
-            this->kingAttacks[us] += (kingAttackWeight[KNIGHT] * popCount(attacksOnEnemyKing));
+            score += term(knightOutpost, us);
         }
     }
 
     return score;
 }
 
-Score Evaluate::bishopScore(Colour colour) {
+template<bool Tracing>
+Score Evaluate<Tracing>::bishopScore(Colour colour) {
     Score score;
 
     Colour us = colour;
     Colour them = ~us;
 
-    Bitboard occupied = position.getOccupied();
     Bitboard bishops = position.getBitboard(BISHOP, us);
 
-    score += pieceValue[BISHOP] * popCount(bishops);
-    if(popCount(position.getBitboard(BISHOP, us)) >= 2) {
-        score += bishopPair;
-    }
-
     while(bishops) {
         Square pieceSquare = popLsb(bishops);
 
-        Bitboard attacksOnEnemyKing = lookups::getKingDangerZone(us, position.getPosition(KING, them));
-        Bitboard attacks = lookups::attacks(BISHOP, pieceSquare, occupied, us);
+        Bitboard attacks = this->attacksFrom[pieceSquare];
 
-        this->attackedByMore[us] |= this->attackedBy[us][ALL_PIECES] & attacks;
-        this->attackedBy[us][BISHOP] |= attacks;
-        this->attackedBy[us][ALL_PIECES] |= attacks;
-
-        score += pieceSquareBonus[BISHOP][relativeSquare(us, pieceSquare)];
-        score += mobilityBonus[BISHOP][popCount(attacks & mobility[us])];
+        score += term(mobilityBonus[BISHOP][popCount(attacks & mobility[us])], us);
         if(getPieceType(position.getPieceOnSquare(pieceSquare + pawnPush(us))) == PAWN) {
-            score += minorBehindPawn;
+            score += term(minorBehindPawn, us);
         }
         if(relativeBoard(us, lookups::getOutpostMask(relativeSquare(us, pieceSquare)))
             && !(relativeBoard(us, lookups::getOutpostMask(relativeSquare(us, pieceSquare))) & position.getBitboard(PAWN, them))) {
-            score += bishopOutpost;
-        }
-
-        if(attacksOnEnemyKing) {
-            this->kingAttacks[us] += (kingAttackWeight[BISHOP] * popCount(attacksOnEnemyKing));
+            score += term(bishopOutpost, us);
         }
     }
 
     return score;
 }
 
-Score Evaluate::rookScore(Colour colour) {
+template<bool Tracing>
+Score Evaluate<Tracing>::rookScore(Colour colour) {
     Score score;
 
     Colour us = colour;
     Colour them = ~us;
 
-    Bitboard occupied = position.getOccupied();
     Bitboard rooks = position.getBitboard(ROOK, us);
 
-    score += pieceValue[ROOK] * popCount(rooks);
-
     while(rooks) {
         Square pieceSquare = popLsb(rooks);
 
-        Bitboard attacksOnEnemyKing = lookups::getKingDangerZone(us, position.getPosition(KING, them));
-        Bitboard attacks = lookups::attacks(ROOK, pieceSquare, occupied, us);
-
-        this->attackedByMore[us] |= this->attackedBy[us][ALL_PIECES] & attacks;
-        this->attackedBy[us][ROOK] |= attacks;
-        this->attackedBy[us][ALL_PIECES] |= attacks;
+        Bitboard attacks = this->attacksFrom[pieceSquare];
 
-        score += pieceSquareBonus[ROOK][relativeSquare(us, pieceSquare)];
-        score += mobilityBonus[ROOK][popCount(attacks & mobility[us])];
+        score += term(mobilityBonus[ROOK][popCount(attacks & mobility[us])], us);
         if(relativeRank(us, pieceSquare) >= RANK_7 && relativeRank(us, position.getPosition(KING, them)) >= RANK_7) {
-            score += rookOnSeventh;
-        }
-
-        if(attacksOnEnemyKing) {
-            this->kingAttacks[us] += (kingAttackWeight[ROOK] * popCount(attacksOnEnemyKing));
+            score += term(rookOnSeventh, us);
         }
     }
 
     return score;
 }
 
-Score Evaluate::queenScore(Colour colour) {
+template<bool Tracing>
+Score Evaluate<Tracing>::queenScore(Colour colour) {
     Score score;
 
     Colour us = colour;
-    Colour them = ~us;
 
-    Bitboard occupied = position.getOccupied();
     Bitboard queens = position.getBitboard(QUEEN, us);
 
-    score += pieceValue[QUEEN] * popCount(queens);
-
     while(queens) {
         Square pieceSquare = popLsb(queens);
 
-        Bitboard attacksOnEnemyKing = lookups::getKingDangerZone(us, position.getPosition(KING, them));
-        Bitboard attacks = lookups::attacks(QUEEN, pieceSquare, occupied, us);
-
-        this->attackedByMore[us] |= this->attackedBy[us][ALL_PIECES] & attacks;
-        this->attackedBy[us][QUEEN] |= attacks;
-        this->attackedBy[us][ALL_PIECES] |= attacks;
+        Bitboard attacks = this->attacksFrom[pieceSquare];
 
-        score += pieceSquareBonus[QUEEN][relativeSquare(us, pieceSquare)];
-        score += mobilityBonus[QUEEN][popCount(attacks & mobility[us])];
-
-        if(attacksOnEnemyKing) {
-            this->kingAttacks[us] += (kingAttackWeight[QUEEN] * popCount(attacksOnEnemyKing));
-        }
+        score += term(mobilityBonus[QUEEN][popCount(attacks & mobility[us])], us);
     }
 
     return score;
 }
 
-Score Evaluate::passedPawnScore(Colour colour) {
+template<bool Tracing>
+Score Evaluate<Tracing>::passedPawnScore(Colour colour) {
     Score score;
 
     Colour us = colour;
@@ -260,7 +312,7 @@ Score Evaluate::passedPawnScore(Colour colour) {
         Bitboard upOne = bitShift(shift(pawnSquare, pawnPush(us)));
 
         if(upOne & occupied) {
-            score += passedRank[rank];
+            score += term(passedRank[rank], us);
         }
         else {
             Bitboard queenLine = us == WHITE ? lookups::getNorth(pawnSquare) : lookups::getSouth(pawnSquare);
@@ -272,17 +324,17 @@ Score Evaluate::passedPawnScore(Colour colour) {
                 defended &= this->attackedBy[us][ALL_PIECES];
             }
             if(!(xrays & position.getBitboardColour(them))) {
-                attacked &= this->attackedBy[us][ALL_PIECES];
+                attacked &= this->attackedBy[them][ALL_PIECES];
             }
 
             if(!attacked) {
-                score += passedRank[rank];
+                score += term(passedRank[rank], us);
             }
             else if(attacked && !defended) {
-                score += (passedRank[rank] * 0.7);
+                score += term(passedRank[rank], us, 0.7) * 7 / 10;
             }
             else {
-                score += (passedRank[rank] * 0.4);
+                score += term(passedRank[rank], us, 0.4) * 4 / 10;
             }
         }
     }
@@ -290,39 +342,8 @@ Score Evaluate::passedPawnScore(Colour colour) {
     return score;
 }
 
-Score Evaluate::kingShelterScore(Colour colour) {
-    Score score;
-
-    Colour us = colour;
-    Colour them = ~us;
-
-    Square kingSquare = position.getPosition(KING, us);
-
-    Bitboard ourPawns = position.getBitboard(PAWN, us);
-    Bitboard theirPawns = position.getBitboard(PAWN, them);
-
-    for(File file = File(std::max(0, int(getFile(kingSquare)) - 1)); file <= std::min(int(FILE_H), int(getFile(kingSquare)) + 1); ++file) {
-        Bitboard ourPawn = ourPawns & lookups::fileMask(file);
-        int ourRank = !ourPawn ? 0 : relativeRank(us, relativeFirstBit(them, ourPawn));
-
-        uint64_t theirPawn = theirPawns & lookups::fileMask(file);
-        int theirRank = !theirPawn ? 0 : relativeRank(us, relativeFirstBit(them, theirPawn));
-
-        int edgeDist = edgeDistance(file);
-        score += pawnShelter[edgeDist][ourRank] / 2;
-
-        if(ourRank && (ourRank == (theirRank - 1))) {
-            score -= blockedPawnStorm[theirRank] / 2;
-        }
-        else {
-            score -= unblockedPawnStorm[edgeDist][theirRank] / 2;
-        }
-    }
-
-    return score;
-}
-
-Score Evaluate::kingScore(Colour colour) {
+template<bool Tracing>
+Score Evaluate<Tracing>::kingScore(Colour colour) {
     Score score;
 
     Colour us = colour;
@@ -333,15 +354,10 @@ Score Evaluate::kingScore(Colour colour) {
     Bitboard ourPawns = position.getBitboard(PAWN, us);
     Bitboard theirPawns = position.getBitboard(PAWN, them);
     Bitboard defenders = ourPawns | position.getBitboard(KNIGHT, us) | position.getBitboard(BISHOP, us);
-    Bitboard attacksByKing = lookups::king(kingSquare);
     Bitboard weakSquares = this->attackedBy[them][ALL_PIECES] & ~this->attackedByMore[us]
         & (~this->attackedBy[us][ALL_PIECES] | this->attackedBy[us][QUEEN] | this->attackedBy[us][KING]);
 
-    this->attackedBy[us][KING] |= attacksByKing;
-    this->attackedBy[us][ALL_PIECES] |= attacksByKing;
-
-    score += pieceSquareBonus[KING][relativeSquare(us, kingSquare)];
-    score += kingDefenders[popCount(defenders & lookups::kingShelter(us, kingSquare))];
+    score += term(kingDefenders[popCount(defenders & lookups::kingShelter(us, kingSquare))], us);
     if(popCount(lookups::kingShelter(us, kingSquare) & this->attackedBy[them][ALL_PIECES]) > 1 - popCount(position.getBitboard(QUEEN, them))) {
         Bitboard knightAttackSquares = lookups::knight(kingSquare);
         Bitboard bishopAttackSquares = lookups::bishop(kingSquare);
@@ -355,21 +371,29 @@ Score Evaluate::kingScore(Colour colour) {
         Bitboard safeRookChecks = rookAttackSquares & this->attackedBy[them][ROOK] & defended;
         Bitboard safeQueenChecks = queenAttackSquares & this->attackedBy[them][QUEEN] & defended;
 
-        Score safetyScore = safeKnightCheckScore * popCount(safeKnightChecks)
-            + safeBishopCheckScore * popCount(safeBishopChecks)
-            + safeRookCheckScore * popCount(safeRookChecks)
-            + safeQueenCheckScore * popCount(safeQueenChecks)
-            + weakSquare * popCount(weakSquares & lookups::kingShelter(us, kingSquare));
+        int knightChecks = popCount(safeKnightChecks);
+        int bishopChecks = popCount(safeBishopChecks);
+        int rookChecks = popCount(safeRookChecks);
+        int queenChecks = popCount(safeQueenChecks);
+        int weakShelter = popCount(weakSquares & lookups::kingShelter(us, kingSquare));
+
+        Score safetyScore = term(safeKnightCheckScore, us, knightChecks) * knightChecks
+            + term(safeBishopCheckScore, us, bishopChecks) * bishopChecks
+            + term(safeRookCheckScore, us, rookChecks) * rookChecks
+            + term(safeQueenCheckScore, us, queenChecks) * queenChecks
+            + term(weakSquare, us, weakShelter) * weakShelter;
 
         score += S(-safetyScore.value(1, 1) * std::max(int(safetyScore.value(1, 1)), 0) / 720, -std::max(int(safetyScore.value(0, 1)), 0) / 20);
     }
 
-    score += kingShelterScore(colour);
+    // The tracing version works the shelter out again instead of taking the cached one
+    score += Tracing ? pawns->shelterScore(position, us, kingSquare, trace) : pawns->kingShelter(position, us);
 
     return score;
 }
 
-Score Evaluate::threatScore(Colour colour) {
+template<bool Tracing>
+Score Evaluate<Tracing>::threatScore(Colour colour) {
     Score score;
 
     Colour us = colour;
@@ -399,41 +423,35 @@ Score Evaluate::threatScore(Colour colour) {
         candidates = (defendedPieces | weakPieces) & (this->attackedBy[us][KNIGHT] | this->attackedBy[us][BISHOP]);
         while(candidates) {
             Square candidateSquare = popLsb(candidates);
-            score += threatByMinor[getPieceType(position.getPieceOnSquare(candidateSquare))];
+            score += term(threatByMinor[getPieceType(position.getPieceOnSquare(candidateSquare))], us);
         }
 
         candidates = weakPieces & this->attackedBy[us][ROOK];
         while(candidates) {
             Square candidateSquare = popLsb(candidates);
-            score += threatByRook[getPieceType(position.getPieceOnSquare(candidateSquare))];
+            score += term(threatByRook[getPieceType(position.getPieceOnSquare(candidateSquare))], us);
         }
 
         if(weakPieces & this->attackedBy[us][KING]) {
-            score += threatByKing;
+            score += term(threatByKing, us);
         }
 
         candidates = ~this->attackedBy[them][ALL_PIECES] | (nonPawnEnemies & this->attackedByMore[us]);
-        score += hangingPiece * popCount(weakPieces & candidates);
+        int hanging = popCount(weakPieces & candidates);
+        score += term(hangingPiece, us, hanging) * hanging;
     }
 
     candidates = safeSquares & ourPawns;
-    score += threatBySafePawn * popCount((shift(candidates, upLeft) | shift(candidates, upRight)) & nonPawnEnemies);
+    int safePawnThreats = popCount((shift(candidates, upLeft) | shift(candidates, upRight)) & nonPawnEnemies);
+    score += term(threatBySafePawn, us, safePawnThreats) * safePawnThreats;
 
     candidates = shift(ourPawns, up) & ~occupied;
     candidates |= shift(candidates & relativeRank3, up) & ~occupied;
     candidates &= ~this->attackedBy[them][PAWN] & safeSquares;
-    score += threatByPawnPush * popCount((shift(candidates, upLeft) | shift(candidates, upRight)) & nonPawnEnemies);
+    int pawnPushThreats = popCount((shift(candidates, upLeft) | shift(candidates, upRight)) & nonPawnEnemies);
+    score += term(threatByPawnPush, us, pawnPushThreats) * pawnPushThreats;
 
     return score;
 }
 
-int Evaluate::getGamePhase() {
-    int phase = 24;
-    for(PieceType pieceType = KNIGHT; pieceType < KING; ++pieceType) {
-        phase -= piecePhase[pieceType] * popCount(position.getBitboard(pieceType));
-    }
-
-    phase = (phase * 256 + 12) / 24;
-
-    return phase;
-}
\ No newline at end of file
+template struct Evaluate<true>;
@@ -3,7 +3,9 @@
 #include <iostream>
 
 #include "uci.h"
+#include "cpu.h"
 #include "defines.h"
+#include "endgame.h"
 #include "position.h"
 #include "search.h"
 #include "thread.h"
@@ -12,11 +14,17 @@
 int main(int argc, char* argv[]) {
     std::ios_base::sync_with_stdio(false);
 
+    CPU::init();
     UCI::init(Options);
     lookups::init();
+    Zobrist::init();
+    PSQT::init();
+    Bitbases::init();
+    Endgames::init();
     Search::init();
     Threads.init();
     TT.resize(Options["Hash"]);
+    EvalHash.resize(Options["Eval Hash"]);
 
     UCI::loop(argc, argv);
 
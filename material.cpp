@@ -0,0 +1,77 @@
+#include "bitboard.h"
+#include "material.h"
+#include "thread.h"
+
+namespace {
+
+    // A lone king against enough material to force mate
+    bool isKXK(const Position& position, Colour us) {
+        return popCount(position.getBitboardColour(~us)) == 1
+            && Material::nonPawnMaterial(position, us) >= valueRookMg;
+    }
+}
+
+int Material::nonPawnMaterial(const Position& position, Colour colour) {
+    int material = 0;
+
+    for(PieceType pieceType = KNIGHT; pieceType < KING; ++pieceType) {
+        material += pieceValue[pieceType].value() * popCount(position.getBitboard(pieceType, colour));
+    }
+
+    return material;
+}
+
+Material::Entry* Material::probe(const Position& position) {
+    Key key = position.getMaterialKey();
+    Entry* entry = position.getThread()->materialTable[key];
+
+    if(entry->key == key) {
+        return entry;
+    }
+
+    entry->key = key;
+    entry->factor[WHITE] = entry->factor[BLACK] = uint8_t(SCALE_FACTOR_NORMAL);
+    entry->evaluationFunction = nullptr;
+
+    // 0 with all the pieces on the board, 256 once only kings and pawns are left
+    int phase = 24;
+    for(PieceType pieceType = KNIGHT; pieceType < KING; ++pieceType) {
+        phase -= piecePhase[pieceType] * popCount(position.getBitboard(pieceType));
+    }
+    entry->phase = (phase * 256 + 12) / 24;
+
+    entry->imbalance = Score();
+    for(Colour colour : { WHITE, BLACK }) {
+        if(popCount(position.getBitboard(BISHOP, colour)) >= 2) {
+            entry->imbalance += colour == WHITE ? bishopPair : -bishopPair;
+        }
+    }
+
+    if(const Endgames::Endgame* endgame = Endgames::probe(key)) {
+        entry->evaluationFunction = endgame->evaluate;
+        entry->strongSide = endgame->strongSide;
+        return entry;
+    }
+
+    for(Colour colour : { WHITE, BLACK }) {
+        if(isKXK(position, colour)) {
+            entry->evaluationFunction = Endgames::evaluateKXK;
+            entry->strongSide = colour;
+            return entry;
+        }
+    }
+
+    // Without pawns a small material edge is rarely enough to win
+    int npm[COLOUR_COUNT] = { nonPawnMaterial(position, WHITE), nonPawnMaterial(position, BLACK) };
+
+    for(Colour us : { WHITE, BLACK }) {
+        Colour them = ~us;
+
+        if(!position.getBitboard(PAWN, us) && npm[us] - npm[them] <= valueBishopMg) {
+            entry->factor[us] = uint8_t(npm[us] < valueRookMg ? SCALE_FACTOR_DRAW
+                : npm[them] <= valueBishopMg ? 4 : 14);
+        }
+    }
+
+    return entry;
+}
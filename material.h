@@ -0,0 +1,33 @@
+#pragma once
+
+#include "defines.h"
+#include "endgame.h"
+#include "evaluate.h"
+#include "position.h"
+#include "utils.h"
+
+namespace Material {
+
+    // What the evaluation works out from the piece counts alone. Entries are looked up
+    // by the material key, which changes only on captures and promotions.
+    struct Entry {
+        int gamePhase() const { return phase; }
+        Score imbalanceScore() const { return imbalance; }
+        ScaleFactor scaleFactor(Colour colour) const { return ScaleFactor(factor[colour]); }
+
+        bool specializedEval() const { return evaluationFunction != nullptr; }
+        Value evaluate(const Position& position) const { return evaluationFunction(position, strongSide); }
+
+        Key key;
+        int phase;
+        Score imbalance; // From white's point of view
+        uint8_t factor[COLOUR_COUNT];
+        Endgames::EvalFunction evaluationFunction;
+        Colour strongSide;
+    };
+
+    typedef HashTable<Entry, 8192> Table;
+
+    Entry* probe(const Position& position);
+    int nonPawnMaterial(const Position& position, Colour colour);
+}
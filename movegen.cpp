@@ -66,20 +66,66 @@ inline ExtMove* getPromotions(Square fromSquare, Square toSquare, ExtMove* moveL
 	return moveList;
 }
 
+// Every helper below only emits legal moves. Moves are restricted to target, which is
+// the set of squares that resolve a check when in check, and a pinned piece may only
+// move along the line through its own king.
+template<Colour us>
+inline Bitboard pinMask(const Position& position, Square from) {
+	return (position.pinned(us) & bitShift(from)) ? lookups::full_ray(from, position.getPosition(KING, us)) : ~Bitboard(0);
+}
+
+// The king may not step onto a square attacked once it has left its current one
+template<Colour us>
+inline Bitboard kingTargets(const Position& position, Bitboard targets) {
+	Square kingSquare = position.getPosition(KING, us);
+	Bitboard kingless = position.getOccupied() ^ bitShift(kingSquare);
+	Bitboard safe = 0;
+
+	while(targets) {
+		Square square = popLsb(targets);
+		if(!position.attackersTo(square, kingless, ~us)) {
+			safe |= bitShift(square);
+		}
+	}
+
+	return safe;
+}
+
+// En passant can expose the king along the rank of both pawns, so it is tested on the
+// resulting occupancy. A checking knight or pawn other than the captured one stays.
+template<Colour us>
+inline bool legalEnPassant(const Position& position, Square from) {
+	constexpr Colour them = ~us;
+
+	Square to = position.getEnPassantSquare();
+	Square captureSquare = to - (us == WHITE ? NORTH : SOUTH);
+	Square kingSquare = position.getPosition(KING, us);
+	Bitboard occupied = (position.getOccupied() ^ bitShift(from) ^ bitShift(captureSquare)) | bitShift(to);
+
+	Bitboard queens = position.getBitboard(QUEEN, them);
+	Bitboard leapers = position.getBitboard(KNIGHT, them) | position.getBitboard(PAWN, them);
+
+	return !(position.getCheckers() & leapers & ~bitShift(captureSquare))
+		&& !(lookups::rook(kingSquare, occupied) & (position.getBitboard(ROOK, them) | queens))
+		&& !(lookups::bishop(kingSquare, occupied) & (position.getBitboard(BISHOP, them) | queens));
+}
+
 // Iterates through all the pieces types to find all possible capture type moves
-ExtMove* generatePieceCaptures(const Position& position, ExtMove* moveList) {
-	Colour us = position.getSide();
-	Colour them = ~us;
+template<Colour us>
+ExtMove* generatePieceCaptures(const Position& position, ExtMove* moveList, Bitboard target) {
+	constexpr Colour them = ~us;
 
 	Bitboard occupied = position.getOccupied();
 	Bitboard themBoard = position.getBitboardColour(them);
 
 	for(PieceType pieceType = KING; pieceType >= KNIGHT; --pieceType) {
-		Bitboard currentPiece = position.getBitboard(PieceType(pieceType), position.getSide());
+		Bitboard currentPiece = position.getBitboard(PieceType(pieceType), us);
 
 		while(currentPiece) {
 			Square fromSquare = popLsb(currentPiece);
 			Bitboard captures = (lookups::attacks(pieceType, fromSquare, occupied) & themBoard);
+
+			captures = pieceType == KING ? kingTargets<us>(position, captures) : captures & target & pinMask<us>(position, fromSquare);
 			while(captures) {
 				Square toSquare = popLsb(captures);
 				*(moveList++) = getMove(fromSquare, toSquare);
@@ -89,9 +135,8 @@ ExtMove* generatePieceCaptures(const Position& position, ExtMove* moveList) {
 	return moveList;
 }
 
-ExtMove* generatePieceQuiets(const Position& position, ExtMove* moveList, bool checks) {
-	Colour us = position.getSide();
-	Colour them = ~us;
+template<Colour us>
+ExtMove* generatePieceQuiets(const Position& position, ExtMove* moveList, Bitboard target) {
 
 	Bitboard occupied = position.getOccupied();
 	Bitboard vacant = ~occupied;
@@ -102,6 +147,8 @@ ExtMove* generatePieceQuiets(const Position& position, ExtMove* moveList, bool c
 		while(pieces) {
 			Square fromSquare = popLsb(pieces);
 			Bitboard possibleMoves = lookups::attacks(pieceType, fromSquare, occupied, us) & vacant;
+
+			possibleMoves = pieceType == KING ? kingTargets<us>(position, possibleMoves) : possibleMoves & target & pinMask<us>(position, fromSquare);
 			while(possibleMoves) {
 				Square toSquare = popLsb(possibleMoves);
 				*(moveList++) = getMove(fromSquare, toSquare);
@@ -112,45 +159,50 @@ ExtMove* generatePieceQuiets(const Position& position, ExtMove* moveList, bool c
 	return moveList;
 }
 
-ExtMove* generatePawnCaptures(const Position& position, ExtMove* moveList) {
-	Colour us = position.getSide();
-	Colour them = ~us;
+template<Colour us>
+ExtMove* generatePawnCaptures(const Position& position, ExtMove* moveList, Bitboard target) {
+	constexpr Colour them = ~us;
 
-	Direction up = pawnPush(us);
-	Direction upLeft = (us == WHITE ? NORTH_WEST : SOUTH_EAST);
-	Direction upRight = (us == WHITE ? NORTH_EAST : SOUTH_WEST);
+	constexpr Direction upLeft = (us == WHITE ? NORTH_WEST : SOUTH_EAST);
+	constexpr Direction upRight = (us == WHITE ? NORTH_EAST : SOUTH_WEST);
 	Bitboard pawns = position.getBitboard(PAWN, us);
 
-	Bitboard emptySquares = ~position.getOccupied();
-	Bitboard rank7Mask = (us == WHITE ? RANK_7_MASK : RANK_2_MASK);
-	Bitboard rank2Mask = (us == WHITE ? RANK_2_MASK : RANK_7_MASK);
+	constexpr Bitboard rank7Mask = (us == WHITE ? RANK_7_MASK : RANK_2_MASK);
 	Bitboard pawnsOnRank7 = pawns & rank7Mask;
-	Bitboard pawnsOnRank2 = pawns & rank2Mask;
 	Bitboard pawnsBeforeRank7 = pawns & ~rank7Mask;
+	Bitboard enemies = position.getBitboardColour(them) & target;
 
-	Bitboard leftCapture = shift(pawnsBeforeRank7, upLeft) & position.getBitboardColour(them);
-	Bitboard rightCapture = shift(pawnsBeforeRank7, upRight) & position.getBitboardColour(them);
+	Bitboard leftCapture = shift(pawnsBeforeRank7, upLeft) & enemies;
+	Bitboard rightCapture = shift(pawnsBeforeRank7, upRight) & enemies;
 	// Adds NORMAL pawn captures to moveList
 	while(leftCapture) {
 		Square toSquare = popLsb(leftCapture);
-		*(moveList++) = getMove(toSquare - upLeft, toSquare);
+		if(pinMask<us>(position, toSquare - upLeft) & bitShift(toSquare)) {
+			*(moveList++) = getMove(toSquare - upLeft, toSquare);
+		}
 	}
 	while(rightCapture) {
 		Square toSquare = popLsb(rightCapture);
-		*(moveList++) = getMove(toSquare - upRight, toSquare);
+		if(pinMask<us>(position, toSquare - upRight) & bitShift(toSquare)) {
+			*(moveList++) = getMove(toSquare - upRight, toSquare);
+		}
 	}
 
 	// Adds PROMOTION pawn moves to moveList
-	leftCapture = shift(pawnsOnRank7, upLeft) & position.getBitboardColour(them);
-	rightCapture = shift(pawnsOnRank7, upRight) & position.getBitboardColour(them);
+	leftCapture = shift(pawnsOnRank7, upLeft) & enemies;
+	rightCapture = shift(pawnsOnRank7, upRight) & enemies;
 
 	while(leftCapture) {
 		Square toSquare = popLsb(leftCapture);
-		moveList = getPromotions(toSquare - upLeft, toSquare, moveList);
+		if(pinMask<us>(position, toSquare - upLeft) & bitShift(toSquare)) {
+			moveList = getPromotions(toSquare - upLeft, toSquare, moveList);
+		}
 	}
 	while(rightCapture) {
 		Square toSquare = popLsb(rightCapture);
-		moveList = getPromotions(toSquare - upRight, toSquare, moveList);
+		if(pinMask<us>(position, toSquare - upRight) & bitShift(toSquare)) {
+			moveList = getPromotions(toSquare - upRight, toSquare, moveList);
+		}
 	}
 
 	if(position.getEnPassantSquare() != NO_SQUARE) {
@@ -158,379 +210,220 @@ ExtMove* generatePawnCaptures(const Position& position, ExtMove* moveList) {
 
 		while(enPassants) {
 			Square fromSquare = popLsb(enPassants);
-			*(moveList++) = getMove(fromSquare, position.getEnPassantSquare(), ENPASSANT);
+			if(legalEnPassant<us>(position, fromSquare)) {
+				*(moveList++) = getMove(fromSquare, position.getEnPassantSquare(), ENPASSANT);
+			}
 		}
 	}
 	return moveList;
 }
 
-ExtMove* generatePawnQuiets(const Position& position, ExtMove* moveList, bool checks) {
-	Colour us = position.getSide();
-	Colour them = ~us;
+template<Colour us>
+ExtMove* generatePawnQuiets(const Position& position, ExtMove* moveList, Bitboard target) {
 
 	Bitboard pawns = position.getBitboard(PAWN, us);
 	Bitboard vacant = ~position.getOccupied();
 
-	Bitboard rank2Mask = (us == WHITE ? RANK_2_MASK : RANK_7_MASK);
-	Bitboard rank3Mask = (us == WHITE ? RANK_3_MASK : RANK_6_MASK);
-	Bitboard rank7Mask = (us == WHITE ? RANK_7_MASK : RANK_2_MASK);
+	constexpr Bitboard rank3Mask = (us == WHITE ? RANK_3_MASK : RANK_6_MASK);
+	constexpr Bitboard rank7Mask = (us == WHITE ? RANK_7_MASK : RANK_2_MASK);
 
-	Direction up = pawnPush(us);
-	Direction upTwice = up * 2;
+	constexpr Direction up = (us == WHITE ? NORTH : SOUTH);
+	constexpr Direction upTwice = up * 2;
 
-	Bitboard pawnsOnRank2 = pawns & rank2Mask;
 	Bitboard pawnsBeforeRank7 = pawns & ~rank7Mask;
 
 	Bitboard singlePush = shift(pawnsBeforeRank7, up) & vacant;
-	Bitboard doublePush = shift((singlePush & rank3Mask), up) & vacant;
+	Bitboard doublePush = shift((singlePush & rank3Mask), up) & vacant & target;
+	singlePush &= target;
 
 	while(singlePush) {
 		Square toSquare = popLsb(singlePush);
-		*(moveList++) = getMove(toSquare - up, toSquare);
+		if(pinMask<us>(position, toSquare - up) & bitShift(toSquare)) {
+			*(moveList++) = getMove(toSquare - up, toSquare);
+		}
 	}
 
 	while(doublePush) {
 		Square toSquare = popLsb(doublePush);
-		*(moveList++) = getMove(toSquare - upTwice, toSquare);
+		if(pinMask<us>(position, toSquare - upTwice) & bitShift(toSquare)) {
+			*(moveList++) = getMove(toSquare - upTwice, toSquare);
+		}
 	}
 
 	return moveList;
 }
-ExtMove* generateQuietPromotions(const Position& position, ExtMove* moveList) {
-	Colour us = position.getSide();
 
-	Direction up = pawnPush(us);
+// Queen promotions are searched with the captures, so that qsearch sees them, and the
+// under promotions with the quiet moves
+template<Colour us>
+ExtMove* generateQuietPromotions(const Position& position, ExtMove* moveList, Bitboard target, bool queens, bool underPromotions) {
+
+	constexpr Direction up = (us == WHITE ? NORTH : SOUTH);
 
-	Bitboard rank7Mask = (us == WHITE ? RANK_7_MASK : RANK_2_MASK);
+	constexpr Bitboard rank7Mask = (us == WHITE ? RANK_7_MASK : RANK_2_MASK);
 	Bitboard pawns = position.getBitboard(PAWN, us);
 	Bitboard pawnsOnRank7 = pawns & rank7Mask;
 
-	Bitboard promotionSquares = shift(pawnsOnRank7, up) & ~position.getOccupied();
+	Bitboard promotionSquares = shift(pawnsOnRank7, up) & ~position.getOccupied() & target;
 	while(promotionSquares) {
 		Square promotionSquare = popLsb(promotionSquares);
-		moveList = getPromotions((promotionSquare - up), promotionSquare, moveList);
+		if(!(pinMask<us>(position, promotionSquare - up) & bitShift(promotionSquare))) {
+			continue;
+		}
+		if(queens) {
+			*(moveList++) = getMove(promotionSquare - up, promotionSquare, PROMOTION, PROMOTE_TO_QUEEN);
+		}
+		if(underPromotions) {
+			*(moveList++) = getMove(promotionSquare - up, promotionSquare, PROMOTION, PROMOTE_TO_KNIGHT);
+			*(moveList++) = getMove(promotionSquare - up, promotionSquare, PROMOTION, PROMOTE_TO_ROOK);
+			*(moveList++) = getMove(promotionSquare - up, promotionSquare, PROMOTION, PROMOTE_TO_BISHOP);
+		}
 	}
 
 	return moveList;
 }
 
+// The king may not castle out of or through check. On the queen side only the squares
+// the king crosses have to be safe, the one next to the rook just has to be empty.
+template<Colour us>
 ExtMove* generateCastling(const Position& position, ExtMove* moveList) {
-	Colour us = position.getSide();
-	Colour them = ~us;
+	constexpr Colour them = ~us;
 
 	Bitboard occupied = position.getOccupied();
-	Bitboard vacant = ~occupied;
 
 	Square kingSquare = position.getPosition(KING, us);
 	int castlingRights = position.getCastlingRights();
-	if(!position.checkersTo(us)) {
-		if(us == WHITE) {
-			if(castlingRights & WHITE_OO) {
-				bool castlePath = true;
-
-				for(int square = 0; square <= 1; ++square) {
-					if((bitShift(castling::kingSide[us][square]) & vacant) && !position.attackersTo(castling::kingSide[us][square], them)) {
-						continue;
-					}
-					else {
-						castlePath = false;
-					}
-				}
-
-				if(castlePath == true) {
-					*(moveList++) = getMove(kingSquare, castling::kingSide[us][1], CASTLING);
-				}
-			}
-			if(castlingRights & WHITE_OOO) {
-				bool castlePath = true;
-
-				for(int square = 0; square <= 2; ++square) {
-					if((bitShift(castling::queenSide[us][square]) & vacant) && !position.attackersTo(castling::queenSide[us][square], them)) {
-						continue;
-					}
-					else {
-						castlePath = false;
-					}
-				}
-
-				if(castlePath == true) {
-					*(moveList++) = getMove(kingSquare, castling::queenSide[us][1], CASTLING);
-				}
-			}
-		}
-		else if(us == BLACK) {
-			if(castlingRights & BLACK_OO) {
-				bool castlePath = true;
-
-				for(int square = 0; square <= 1; ++square) {
-					if((bitShift(castling::kingSide[us][square]) & vacant) && !position.attackersTo(castling::kingSide[us][square], them)) {
-						continue;
-					}
-					else {
-						castlePath = false;
-					}
-				}
-
-				if(castlePath == true) {
-					*(moveList++) = getMove(kingSquare, castling::kingSide[us][1], CASTLING);
-				}
-			}
-			if(castlingRights & BLACK_OOO) {
-				bool castlePath = true;
-
-				for(int square = 0; square <= 2; ++square) {
-					if((bitShift(castling::queenSide[us][square]) & vacant) && !position.attackersTo(castling::queenSide[us][square], them)) {
-						continue;
-					}
-					else {
-						castlePath = false;
-					}
-				}
-
-				if(castlePath == true) {
-					*(moveList++) = getMove(kingSquare, castling::queenSide[us][1], CASTLING);
-				}
-			}
-		}
-	}
-
-	return moveList;
-}
-
-ExtMove* generateCheckerCaptures(const Position& position, ExtMove* moveList) {
-	Colour us = position.getSide();
-	Colour them = ~us;
-
-	Direction down = -pawnPush(us);
+	constexpr int kingSideRight = us == WHITE ? WHITE_OO : BLACK_OO;
+	constexpr int queenSideRight = us == WHITE ? WHITE_OOO : BLACK_OOO;
 
-	Bitboard notKingSquare = ~position.getBitboard(KING, us);
-	Bitboard pawns = position.getBitboard(PAWN, us);
-	Bitboard occupied = position.getOccupied();
-	Bitboard checkers = position.checkersTo(us);
-
-	Square enPassantSquare = position.getEnPassantSquare();
-	if(enPassantSquare != NO_SQUARE && (checkers & shift(bitShift(enPassantSquare), down))) {
-		Bitboard pawnAttackers = pawns & relativeBoard(us, lookups::pawn(enPassantSquare, them));
-
-		while(pawnAttackers) {
-			Square attacker = popLsb(pawnAttackers);
-			*(moveList++) = getMove(attacker, enPassantSquare, ENPASSANT);
-		}
+	if(position.getCheckers()) {
+		return moveList;
 	}
 
-	while(checkers) {
-		Square checker = popLsb(checkers);
-		Piece checkerPiece = position.getPieceOnSquare(checker);
-
-		Bitboard attackers = relativeBoard(us, position.attackersTo(checker, occupied, us)) & notKingSquare;
+	if(castlingRights & kingSideRight) {
+		bool castlePath = true;
 
-		while(attackers) {
-			Square attacker = popLsb(attackers);
-			// If the attacker is a pawn and gets to the 8th rank (promotes)
-			if((bitShift(attacker) & pawns) && (bitShift(checker) & RANK_8_MASK)) {
-				moveList = getPromotions(attacker, checker, moveList);
-			}
-			else {
-				*(moveList++) = getMove(attacker, checker);
+		for(int square = 0; square <= 1; ++square) {
+			if((bitShift(castling::kingSide[us][square]) & occupied) || position.attackersTo(castling::kingSide[us][square], them)) {
+				castlePath = false;
 			}
 		}
-	}
-
-	return moveList;
-}
-
-ExtMove* generateCheckBlocks(const Position& position, ExtMove* moveList) {
-	Colour us = position.getSide();
-	Colour them = ~us;
-
-	Direction down = -pawnPush(us);
 
-	Square kingSquare = position.getPosition(KING, us);
-
-	Rank rank4Mask = (us == WHITE ? RANK_4 : RANK_5);
-
-	Bitboard occupied = position.getOccupied();
-	Bitboard vacant = ~occupied;
-	Bitboard pawns = position.getBitboard(PAWN, us);
-	Bitboard checkers = position.checkersTo(us);
-	Bitboard movablePieces = ~(pawns | position.getBitboard(KING, us) | position.pinned(us));
-	Bitboard blockerSquares = lookups::intervening_sqs(fbitscan(checkers), kingSquare);
-
-	while(blockerSquares) {
-		Square squareToBlock = popLsb(blockerSquares);
-
-		Bitboard pawnBlockers = shift(bitShift(squareToBlock), down);
-		if(pawnBlockers & pawns) {
-			Square pawnFrom = fbitscan(pawnBlockers);
+		if(castlePath == true) {
+			*(moveList++) = getMove(kingSquare, castling::kingSide[us][1], CASTLING);
+		}
+	}
+	if(castlingRights & queenSideRight) {
+		bool castlePath = true;
 
-			if(bitShift(pawnFrom) & RANK_8_MASK) {
-				moveList = getPromotions(pawnFrom, squareToBlock, moveList);
-			}
-			else {
-				*(moveList++) = getMove(pawnFrom, squareToBlock);
+		for(int square = 0; square <= 2; ++square) {
+			if((bitShift(castling::queenSide[us][square]) & occupied)
+				|| (square > 0 && position.attackersTo(castling::queenSide[us][square], them))) {
+				castlePath = false;
 			}
 		}
-		// Check if blockerSquare is on Rank 4, if it is, check if we can do a double push for a pawn on Rank 2
-		else if((getRank(squareToBlock) == rank4Mask) && (pawnBlockers & vacant) && (shift(pawnBlockers, down) & pawns)) {
-			*(moveList++) = getMove(fbitscan(shift(pawnBlockers, down)), squareToBlock);
-		}
 
-		Bitboard blockerCandidates = position.attackersTo(squareToBlock, occupied, us) & movablePieces;
-		while(blockerCandidates) {
-			Square blockingPiece = popLsb(blockerCandidates);
-			*(moveList++) = getMove(blockingPiece, squareToBlock);
+		if(castlePath == true) {
+			*(moveList++) = getMove(kingSquare, castling::queenSide[us][1], CASTLING);
 		}
 	}
 
 	return moveList;
 }
 
+// Against a single check any piece may capture the checker or block the line. In double
+// check only the king can move.
+template<Colour us>
 ExtMove* generateEvasions(const Position& position, ExtMove* moveList) {
-	Colour us = position.getSide();
-	Colour them = ~us;
 
 	Square kingSquare = position.getPosition(KING, us);
+	Bitboard checkers = position.getCheckers();
 
-	Bitboard checkers = position.checkersTo(us);
-	Bitboard occupied = position.getOccupied();
-	Bitboard kingless = occupied ^ bitShift(kingSquare);
-
-	Bitboard evasionSquares = lookups::king(kingSquare) & ~position.getBitboardColour(us);
+	if(checkers & (checkers - 1)) {
+		Bitboard kingMoves = kingTargets<us>(position, lookups::king(kingSquare) & ~position.getBitboardColour(us));
 
-	while(evasionSquares) {
-		Square squareForEvasion = popLsb(evasionSquares);
-
-		if(!position.attackersTo(squareForEvasion, kingless, them)) {
-			*(moveList++) = getMove(kingSquare, squareForEvasion);
+		while(kingMoves) {
+			*(moveList++) = getMove(kingSquare, popLsb(kingMoves));
 		}
+
+		return moveList;
 	}
 
-	moveList = generateCheckerCaptures(position, moveList);
-	moveList = generateCheckBlocks(position, moveList);
+	Bitboard target = checkers | lookups::intervening_sqs(fbitscan(checkers), kingSquare);
 
-	return moveList;
-}
-
-ExtMove* generateTacticalMoves(const Position& position, ExtMove* moveList) {
-	moveList = generatePawnCaptures(position, moveList);
-	moveList = generatePieceCaptures(position, moveList);
+	moveList = generatePawnCaptures<us>(position, moveList, target);
+	moveList = generatePieceCaptures<us>(position, moveList, target);
+	moveList = generatePawnQuiets<us>(position, moveList, target);
+	moveList = generatePieceQuiets<us>(position, moveList, target);
+	moveList = generateQuietPromotions<us>(position, moveList, target, true, true);
 
 	return moveList;
 }
 
-ExtMove* generateCaptureMoves(const Position& position, ExtMove* moveList) {
-	moveList = generatePawnCaptures(position, moveList);
-	moveList = generatePieceCaptures(position, moveList);
+template<Colour us, GenType Type>
+ExtMove* generateAll(const Position& position, ExtMove* moveList) {
+	constexpr Bitboard all = ~Bitboard(0);
 
-	return moveList;
-}
-
-ExtMove* generateQuietMoves(const Position& position, ExtMove* moveList, bool checks) {
-	moveList = generateCastling(position, moveList);
-	moveList = generatePawnQuiets(position, moveList, checks);
-	moveList = generatePieceQuiets(position, moveList, checks);
-	moveList = generateQuietPromotions(position, moveList);
+	if constexpr(Type == EVASIONS) {
+		return generateEvasions<us>(position, moveList);
+	}
 
-	return moveList;
-}
+	if constexpr(Type == CAPTURES || Type == NON_EVASIONS) {
+		moveList = generatePawnCaptures<us>(position, moveList, all);
+		moveList = generateQuietPromotions<us>(position, moveList, all, true, false);
+		moveList = generatePieceCaptures<us>(position, moveList, all);
+	}
 
-ExtMove* generateMoves(const Position& position, ExtMove* moveList) {
-	moveList = generateTacticalMoves(position, moveList);
-	moveList = generateQuietMoves(position, moveList);
+	if constexpr(Type == QUIETS || Type == NON_EVASIONS) {
+		moveList = generateCastling<us>(position, moveList);
+		moveList = generatePawnQuiets<us>(position, moveList, all);
+		moveList = generatePieceQuiets<us>(position, moveList, all);
+		moveList = generateQuietPromotions<us>(position, moveList, all, false, true);
+	}
 
 	return moveList;
 }
 
-bool checkPseudoLegal(const Position& position, Move move) {
-	if(move == NO_MOVE) {
-		return false;
-	}
-	Colour us = position.getSide();
-	Colour them = ~us;
-
-	Square from = getFrom(move);
-	Square to = getTo(move);
-	Square kingSquare = position.getPosition(KING, us);
-	if(position.getPieceOnSquare(from) == NO_PIECE
-		|| position.getPieceColour(position.getPieceOnSquare(from)) != us
-		|| (position.getPieceColour(position.getPieceOnSquare(from)) == position.getPieceColour(position.getPieceOnSquare(to)))) {
-		return false;
-	}
+template<GenType Type>
+ExtMove* generate(const Position& position, ExtMove* moveList) {
+	static_assert(Type == CAPTURES || Type == QUIETS || Type == EVASIONS || Type == NON_EVASIONS);
+	assert((Type == EVASIONS) == bool(position.getCheckers()));
 
-	if(move & ENPASSANT) {
-		Direction down = -pawnPush(us);
+	return position.getSide() == WHITE ? generateAll<WHITE, Type>(position, moveList)
+		: generateAll<BLACK, Type>(position, moveList);
+}
 
-		Bitboard toBoard = bitShift(position.getEnPassantSquare());
-		Bitboard capture = shift(to, down);
-		Bitboard pieces = (position.getOccupied() ^ bitShift(from) ^ capture) | toBoard;
+template ExtMove* generate<CAPTURES>(const Position&, ExtMove*);
+template ExtMove* generate<QUIETS>(const Position&, ExtMove*);
+template ExtMove* generate<EVASIONS>(const Position&, ExtMove*);
+template ExtMove* generate<NON_EVASIONS>(const Position&, ExtMove*);
 
-		Bitboard queen = position.getBitboard(QUEEN);
-		Bitboard rookQueen = position.getBitboard(ROOK) | queen;
-		Bitboard bishopQueen = position.getBitboard(BISHOP) | queen;
-		Bitboard opponent = position.getBitboardColour(them);
+// Quiet moves giving check, for the first ply of qsearch
+template<>
+ExtMove* generate<QUIET_CHECKS>(const Position& position, ExtMove* moveList) {
+	ExtMove* begin = moveList;
+	ExtMove* end = generate<QUIETS>(position, moveList);
 
-		return !(lookups::rook(kingSquare, pieces) & (rookQueen & opponent))
-			&& !(lookups::bishop(kingSquare, pieces) & (bishopQueen & opponent));
-	}
-	else if(from == kingSquare) {
-		return (getMoveType(move) == CASTLING) || !(position.attackersTo(to, them));
+	for(ExtMove* move = begin; move < end; ++move) {
+		if(getMoveType(*move) != PROMOTION && position.givesCheck(*move)) {
+			*(moveList++) = *move;
+		}
 	}
 
-	return true;
+	return moveList;
 }
 
-int generateLegalMoves(const Position& position, ExtMove* moveList) {
-	ExtMove pseudoMoves[MAX_MOVES];
-	ExtMove* end = pseudoMoves;
-	ExtMove* start = pseudoMoves;
-	int size = 0;
-
-	if(position.checkersTo(position.getSide())) {
-		end = generateEvasions(position, pseudoMoves);
-	}
-	else {
-		end = generateMoves(position, pseudoMoves);
-	}
-
-	for(int i = 0; i < end - pseudoMoves; ++i) {
-		if(position.checkLegality(pseudoMoves[i])) {
-			moveList[size++] = pseudoMoves[i];
-		}
-	}
+template<>
+ExtMove* generate<LEGAL>(const Position& position, ExtMove* moveList) {
+	return position.getCheckers() ? generate<EVASIONS>(position, moveList)
+		: generate<NON_EVASIONS>(position, moveList);
+}
 
-	return size;
+int generateLegalMoves(const Position& position, ExtMove* moveList) {
+	return int(generate<LEGAL>(position, moveList) - moveList);
 }
 
 bool checkTactical(Position* position, Move move) {
 	return (position->getPieceOnSquare(getTo(move)) != NO_PIECE && getMoveType(move) != CASTLING)
 		|| (getMoveType(move) == ENPASSANT || getMoveType(move) == PROMOTION);
 }
-
-uint64_t perft(Position position, Depth depth, bool root) {
-	ExtMove moveList[MAX_MOVES];
-	uint64_t leaves = uint64_t(0);
-	Undo undo[1];
-	int u = 0;
-	int size = generateLegalMoves(position, moveList);
-	if(depth == 1) {
-		return size;
-	}
-	for(size -= 1; size >= 0; size--) {
-		Position child = position;
-		child.makeMove(undo, moveList[size]);
-		if(child.checkersTo(~child.getSide())) {
-			child.undoMove(undo, moveList[size]);
-			continue;
-		}
-
-		uint64_t count = perft(child, depth - 1, false);
-		leaves += count;
-
-
-		if(root == true) {
-			std::cout << getMoveString(moveList[size]) << ": " << count << std::endl;
-		}
-	}
-
-	return leaves;
-}
\ No newline at end of file
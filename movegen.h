@@ -35,17 +35,13 @@ inline Move getMove(Square fromSquare, Square toSquare, MoveType moveType = NORM
 	return Move(toSquare | (fromSquare << 6) | moveType | promotionType);
 }
 
+// False for NO_MOVE and NULL_MOVE
+inline bool isValidMove(Move move) { return getFrom(move) != getTo(move); }
+
 std::string getMoveString(Move move);
-// int generateLegalEvasions(const Position& position, std::vector<Move>& moveList);
-// int generateLegalTacticalMoves(const Position& position, std::vector<Move>& moveList);
-ExtMove* generateTacticalMoves(const Position& position, ExtMove* moveList);
-ExtMove* generateCaptureMoves(const Position& position, ExtMove* moveList);
-ExtMove* generateQuietMoves(const Position& position, ExtMove* moveList, bool checks = false);
-ExtMove* generateEvasions(const Position& position, ExtMove* moveList);
+// All generators only return legal moves
+template<GenType>
+ExtMove* generate(const Position& position, ExtMove* moveList);
 int generateLegalMoves(const Position& position, ExtMove* moveList);
-ExtMove* generateMoves(const Position& position, ExtMove* moveList);
-bool checkPseudoLegal(const Position& position, Move move);
 bool checkTactical(Position* position, Move move);
-void print_bb(Bitboard bb);
-
-uint64_t perft(Position position, Depth depth, bool root = true);
\ No newline at end of file
+void print_bb(Bitboard bb);
\ No newline at end of file
@@ -43,8 +43,8 @@ MovePicker::MovePicker(const Position& p, Move ttm, Depth d, const HistoryStats&
 
     assert(d > DEPTH_ZERO);
 
-    stage = position.checkersTo(position.getSide()) ? EVASION : MAIN_SEARCH;
-    ttMove = ttm && position.checkLegality(ttm) ? ttm : NO_MOVE;
+    stage = position.getCheckers() ? EVASION : MAIN_SEARCH;
+    ttMove = ttm && position.checkPseudoLegal(ttm) && position.checkLegality(ttm) ? ttm : NO_MOVE;
     endMoves += (ttMove != NO_MOVE);
 }
 
@@ -54,7 +54,7 @@ MovePicker::MovePicker(const Position& p, Move ttm, Depth d,
 
     assert(d <= DEPTH_ZERO);
 
-    if(position.checkersTo(position.getSide())) {
+    if(position.getCheckers()) {
         stage = EVASION;
     }
 
@@ -72,22 +72,23 @@ MovePicker::MovePicker(const Position& p, Move ttm, Depth d,
         ttm = NO_MOVE;
     }
 
-    ttMove = ttm && position.checkLegality(ttm) ? ttm : NO_MOVE;
+    ttMove = ttm && position.checkPseudoLegal(ttm) && position.checkLegality(ttm) ? ttm : NO_MOVE;
     endMoves += (ttMove != NO_MOVE);
 }
 
 MovePicker::MovePicker(const Position& p, Move ttm, const HistoryStats& h, Value th)
     : position(p), history(h), counterMovesHistory(nullptr), threshold(th) {
 
-    assert(!position.checkersTo(position.getSide()));
+    assert(!position.getCheckers());
 
     stage = PROBCUT;
 
     // In ProbCut we generate captures with SEE higher than the given threshold
     ttMove = ttm
+        && position.checkPseudoLegal(ttm)
         && position.checkLegality(ttm)
         && position.checkCapture(ttm)
-        && position.see(ttm) > threshold ? ttm : NO_MOVE;
+        && position.see_ge(ttm, threshold + 1) ? ttm : NO_MOVE;
 
     endMoves += (ttMove != NO_MOVE);
 }
@@ -95,7 +96,7 @@ MovePicker::MovePicker(const Position& p, Move ttm, const HistoryStats& h, Value
 template<>
 void MovePicker::score<CAPTURES>() {
     for(auto& move : *this)
-        move.value = (Value)pieceValue[position.getPieceOnSquare(getTo(move))].value()
+        move.value = (Value)pieceValue[getPieceType(position.getPieceOnSquare(getTo(move)))].value()
         - Value(200 * relativeRank(position.getSide(), getRank(getTo(move))));
 }
 
@@ -109,14 +110,12 @@ void MovePicker::score<QUIETS>() {
 
 template<>
 void MovePicker::score<EVASIONS>() {
-    Value see;
-
     for(auto& move : *this)
-        if((see = position.seeSign(move)) < VALUE_ZERO)
-            move.value = see - HistoryStats::Max; // At the bottom
+        if(!position.see_ge(move))
+            move.value = Value(-HistoryStats::Max); // At the bottom
 
         else if(position.checkCapture(move))
-            move.value = (Value)pieceValue[position.getPieceOnSquare(getTo(move))].value()
+            move.value = (Value)pieceValue[getPieceType(position.getPieceOnSquare(getTo(move)))].value()
             - Value(getPieceType(position.getPieceOnSquare(getFrom(move)))) + HistoryStats::Max;
         else
             move.value = history[position.getPieceOnSquare(getFrom(move))][getTo(move)];
@@ -131,7 +130,7 @@ void MovePicker::generate_next_stage() {
 
     case GOOD_CAPTURES: case QCAPTURES_1: case QCAPTURES_2:
     case PROBCUT_CAPTURES: case RECAPTURES:
-        endMoves = generateCaptureMoves(position, moves);
+        endMoves = generate<CAPTURES>(position, moves);
         score<CAPTURES>();
         break;
 
@@ -144,7 +143,7 @@ void MovePicker::generate_next_stage() {
         break;
 
     case GOOD_QUIETS:
-        endQuiets = endMoves = generateQuietMoves(position, moves);
+        endQuiets = endMoves = generate<QUIETS>(position, moves);
         score<QUIETS>();
         endMoves = std::partition(curr, endMoves, [](const ExtMove& move) {
             return move.value > VALUE_ZERO;
@@ -166,14 +165,14 @@ void MovePicker::generate_next_stage() {
         break;
 
     case ALL_EVASIONS:
-        endMoves = generateEvasions(position, moves);
+        endMoves = generate<EVASIONS>(position, moves);
         if(endMoves - moves > 1) {
             score<EVASIONS>();
         }
         break;
 
     case CHECKS:
-        endMoves = generateTacticalMoves(position, moves);
+        endMoves = generate<QUIET_CHECKS>(position, moves);
         break;
 
     case EVASION: case QSEARCH_WITH_CHECKS: case QSEARCH_WITHOUT_CHECKS:
@@ -205,7 +204,7 @@ Move MovePicker::next_move() {
             move = pick_best(curr++, endMoves);
             if(move != ttMove)
             {
-                if(position.seeSign(move) >= VALUE_ZERO)
+                if(position.see_ge(move))
                     return move;
 
                 // Losing capture, move it to the tail of the array
@@ -217,6 +216,7 @@ Move MovePicker::next_move() {
             move = *curr++;
             if(move != NO_MOVE
                 && move != ttMove
+                && position.checkPseudoLegal(move)
                 && position.checkLegality(move)
                 && !position.checkCapture(move))
                 return move;
@@ -242,7 +242,7 @@ Move MovePicker::next_move() {
 
         case PROBCUT_CAPTURES:
             move = pick_best(curr++, endMoves);
-            if(move != ttMove && position.see(move) > threshold)
+            if(move != ttMove && position.see_ge(move, threshold + 1))
                 return move;
             break;
 
@@ -0,0 +1,426 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "cpu.h"
+#include "nnue.h"
+#include "position.h"
+#include "thread.h"
+
+namespace {
+
+    // Stockfish 12 net layout: 41024 HalfKP inputs, 256 accumulator values per side,
+    // then 512 -> 32 -> 32 -> 1 with clipped ReLU activations in between
+    constexpr uint32_t Version = 0x7AF32F16;
+    constexpr int PieceSquareCount = 10 * SQUARE_COUNT + 1;
+    constexpr int InputDimensions = SQUARE_COUNT * PieceSquareCount;
+    constexpr int TransformedDimensions = 2 * NNUE::HalfDimensions;
+    constexpr int HiddenDimensions = 32;
+    constexpr int WeightScaleBits = 6;
+    constexpr int OutputScale = 16;
+
+    // Dot products of clipped activations and one row of int8 weights, whose length is
+    // always a multiple of 32, and updates of the accumulator by one weight column of
+    // the feature transformer. There is one version per instruction set tier.
+    int32_t dotScalar(const uint8_t* input, const int8_t* weights, int count) {
+        int32_t sum = 0;
+
+        for(int j = 0; j < count; ++j) {
+            sum += int32_t(input[j]) * weights[j];
+        }
+
+        return sum;
+    }
+
+    template<bool Add>
+    void updateColumnScalar(int16_t* values, const int16_t* column) {
+        for(int j = 0; j < NNUE::HalfDimensions; ++j) {
+            values[j] = Add ? values[j] + column[j] : values[j] - column[j];
+        }
+    }
+
+    TARGET("sse4.2") int32_t dotSse(const uint8_t* input, const int8_t* weights, int count) {
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i sum = _mm_setzero_si128();
+
+        for(int j = 0; j < count; j += 16) {
+            __m128i product = _mm_maddubs_epi16(
+                _mm_load_si128(reinterpret_cast<const __m128i*>(&input[j])),
+                _mm_load_si128(reinterpret_cast<const __m128i*>(&weights[j])));
+
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(product, ones));
+        }
+
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+
+        return _mm_cvtsi128_si32(sum);
+    }
+
+    template<bool Add>
+    TARGET("sse4.2") void updateColumnSse(int16_t* values, const int16_t* column) {
+        for(int j = 0; j < NNUE::HalfDimensions; j += 8) {
+            __m128i* value = reinterpret_cast<__m128i*>(&values[j]);
+            __m128i weight = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&column[j]));
+
+            *value = Add ? _mm_add_epi16(*value, weight) : _mm_sub_epi16(*value, weight);
+        }
+    }
+
+    TARGET("avx2") inline int32_t horizontalAdd(__m256i sum) {
+        __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+        sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+
+        return _mm_cvtsi128_si32(sum128);
+    }
+
+    TARGET("avx2") int32_t dotAvx2(const uint8_t* input, const int8_t* weights, int count) {
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i sum = _mm256_setzero_si256();
+
+        for(int j = 0; j < count; j += 32) {
+            __m256i product = _mm256_maddubs_epi16(
+                _mm256_load_si256(reinterpret_cast<const __m256i*>(&input[j])),
+                _mm256_load_si256(reinterpret_cast<const __m256i*>(&weights[j])));
+
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(product, ones));
+        }
+
+        return horizontalAdd(sum);
+    }
+
+    template<bool Add>
+    TARGET("avx2") void updateColumnAvx2(int16_t* values, const int16_t* column) {
+        for(int j = 0; j < NNUE::HalfDimensions; j += 16) {
+            __m256i* value = reinterpret_cast<__m256i*>(&values[j]);
+            __m256i weight = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&column[j]));
+
+            *value = Add ? _mm256_add_epi16(*value, weight) : _mm256_sub_epi16(*value, weight);
+        }
+    }
+
+    // The small hidden layers are only 32 wide, which does not fill the 64 byte loop
+    TARGET("avx512f,avx512bw") int32_t dotAvx512(const uint8_t* input, const int8_t* weights, int count) {
+        if(count % 64) {
+            return dotAvx2(input, weights, count);
+        }
+
+        const __m512i ones = _mm512_set1_epi16(1);
+        __m512i sum = _mm512_setzero_si512();
+
+        for(int j = 0; j < count; j += 64) {
+            __m512i product = _mm512_maddubs_epi16(
+                _mm512_load_si512(reinterpret_cast<const __m512i*>(&input[j])),
+                _mm512_load_si512(reinterpret_cast<const __m512i*>(&weights[j])));
+
+            sum = _mm512_add_epi32(sum, _mm512_madd_epi16(product, ones));
+        }
+
+        // The halves are taken with a full zeroing mask, as the plain cast and extract
+        // start from an undefined register that GCC warns about
+        return horizontalAdd(_mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xFF, sum, 0),
+            _mm512_maskz_extracti64x4_epi64(0xFF, sum, 1)));
+    }
+
+    template<bool Add>
+    TARGET("avx512f,avx512bw") void updateColumnAvx512(int16_t* values, const int16_t* column) {
+        for(int j = 0; j < NNUE::HalfDimensions; j += 32) {
+            __m512i* value = reinterpret_cast<__m512i*>(&values[j]);
+            __m512i weight = _mm512_loadu_si512(reinterpret_cast<const __m512i*>(&column[j]));
+
+            *value = Add ? _mm512_add_epi16(*value, weight) : _mm512_sub_epi16(*value, weight);
+        }
+    }
+
+    struct Kernels {
+        int32_t (*dot)(const uint8_t* input, const int8_t* weights, int count);
+        void (*add)(int16_t* values, const int16_t* column);
+        void (*subtract)(int16_t* values, const int16_t* column);
+    };
+
+    const Kernels TierKernels[CPU::TIER_COUNT] = {
+        { dotScalar, updateColumnScalar<true>, updateColumnScalar<false> },
+        { dotSse, updateColumnSse<true>, updateColumnSse<false> },
+        { dotAvx2, updateColumnAvx2<true>, updateColumnAvx2<false> },
+        { dotAvx512, updateColumnAvx512<true>, updateColumnAvx512<false> }
+    };
+
+    // Chosen when a network is loaded, which is always after the processor was examined
+    Kernels kernels = TierKernels[CPU::SCALAR];
+
+    int32_t dot(const uint8_t* input, const int8_t* weights, int count) {
+        return kernels.dot(input, weights, count);
+    }
+
+    template<bool Add>
+    void updateColumn(int16_t* values, const int16_t* column) {
+        Add ? kernels.add(values, column) : kernels.subtract(values, column);
+    }
+
+    template<int In, int Out>
+    struct AffineLayer {
+        alignas(64) int32_t biases[Out];
+        alignas(64) int8_t weights[Out * In];
+
+        void propagate(const uint8_t* input, int32_t* output) const {
+            for(int i = 0; i < Out; ++i) {
+                output[i] = biases[i] + dot(input, &weights[i * In], In);
+            }
+        }
+
+        bool read(std::istream& stream) {
+            stream.read(reinterpret_cast<char*>(biases), sizeof(biases));
+            stream.read(reinterpret_cast<char*>(weights), sizeof(weights));
+
+            return bool(stream);
+        }
+    };
+
+    template<int Size>
+    void clippedReLU(const int32_t* input, uint8_t* output) {
+        for(int i = 0; i < Size; ++i) {
+            output[i] = uint8_t(std::clamp(input[i] >> WeightScaleBits, 0, 127));
+        }
+    }
+
+    struct Network {
+        alignas(64) int16_t transformerBiases[NNUE::HalfDimensions];
+        std::vector<int16_t> transformerWeights = std::vector<int16_t>(size_t(InputDimensions) * NNUE::HalfDimensions);
+
+        AffineLayer<TransformedDimensions, HiddenDimensions> hidden1;
+        AffineLayer<HiddenDimensions, HiddenDimensions> hidden2;
+        AffineLayer<HiddenDimensions, 1> output;
+    };
+
+    std::unique_ptr<Network> network;
+    int networkId = 0;
+    bool useNetwork = false;
+
+    uint32_t readHeader(std::istream& stream) {
+        uint32_t value = 0;
+        stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+
+        return value;
+    }
+
+    // Both sides see the board from their own first rank, so black's view is turned
+    // around. Kings are not features, only the square of the own king is.
+    int featureIndex(Colour perspective, Square kingSquare, Piece piece, Square square) {
+        int flip = perspective == WHITE ? 0 : 63;
+        int pieceIndex = 1 + ((piece & 7) - PAWN) * 2 * SQUARE_COUNT + ((piece >> 3) == perspective ? 0 : SQUARE_COUNT);
+
+        return (square ^ flip) + pieceIndex + PieceSquareCount * (kingSquare ^ flip);
+    }
+
+    const int16_t* column(Colour perspective, Square kingSquare, Piece piece, Square square) {
+        return &network->transformerWeights[size_t(featureIndex(perspective, kingSquare, piece, square)) * NNUE::HalfDimensions];
+    }
+
+    void refresh(const Position& position, Colour perspective, NNUE::Accumulator& accumulator) {
+        int16_t* values = accumulator.values[perspective];
+        Square kingSquare = position.getPosition(KING, perspective);
+        Bitboard pieces = position.getOccupied() & ~position.getBitboard(KING);
+
+        std::memcpy(values, network->transformerBiases, sizeof(network->transformerBiases));
+
+        while(pieces) {
+            Square square = popLsb(pieces);
+
+            updateColumn<true>(values, column(perspective, kingSquare, position.getPieceOnSquare(square), square));
+        }
+    }
+
+    // Like refresh, but starts from what the thread last built for this king square
+    void refreshFromCache(const Position& position, Colour perspective, NNUE::Accumulator& accumulator) {
+        NNUE::RefreshCache& cache = position.getThread()->refreshCache;
+        Square kingSquare = position.getPosition(KING, perspective);
+
+        if(cache.network != networkId) {
+            for(auto& squareEntries : cache.entries) {
+                for(NNUE::RefreshEntry& entry : squareEntries) {
+                    std::memcpy(entry.values, network->transformerBiases, sizeof(entry.values));
+                    std::memset(entry.pieces, 0, sizeof(entry.pieces));
+                }
+            }
+            cache.network = networkId;
+        }
+
+        NNUE::RefreshEntry& entry = cache.entries[kingSquare][perspective];
+
+        for(Colour colour : { WHITE, BLACK }) {
+            for(PieceType pieceType = PAWN; pieceType < KING; ++pieceType) {
+                Piece piece = Piece(pieceType + 8 * colour);
+                Bitboard pieces = position.getBitboard(pieceType, colour);
+                Bitboard removed = entry.pieces[colour][pieceType] & ~pieces;
+                Bitboard added = pieces & ~entry.pieces[colour][pieceType];
+
+                while(removed) {
+                    updateColumn<false>(entry.values, column(perspective, kingSquare, piece, popLsb(removed)));
+                }
+                while(added) {
+                    updateColumn<true>(entry.values, column(perspective, kingSquare, piece, popLsb(added)));
+                }
+
+                entry.pieces[colour][pieceType] = pieces;
+            }
+        }
+
+        std::memcpy(accumulator.values[perspective], entry.values, sizeof(entry.values));
+    }
+
+    // The entry of the current ply, once everything built with an earlier network is gone
+    NNUE::Accumulator& currentAccumulator(const Position& position) {
+        NNUE::AccumulatorStack& stack = position.getThread()->accumulators;
+
+        if(stack.network != networkId) {
+            for(NNUE::Accumulator& accumulator : stack.entries) {
+                accumulator.key[WHITE] = accumulator.key[BLACK] = 0;
+            }
+            stack.network = networkId;
+        }
+
+        return stack[position.getPly()];
+    }
+
+    // Moves only record what they changed. The first evaluation after them walks back to
+    // the nearest ply whose accumulator was built for the position there and applies every
+    // change made since, which works in any order because the updates are plain additions.
+    // A king move of this side changes all its features, so the walk stops there and
+    // rebuilds instead.
+    void resolve(const Position& position, Colour perspective) {
+        NNUE::AccumulatorStack& stack = position.getThread()->accumulators;
+        NNUE::Accumulator& accumulator = stack[position.getPly()];
+        const StateInfo* st = position.getState();
+        const StateInfo* state = st;
+        Piece king = Piece(KING + 8 * perspective);
+        int back = 0;
+
+        while(stack[position.getPly() - back].key[perspective] != state->positionKey) {
+            if(!state->previous || state->dirtyPiece.piece[0] == king || back == NNUE::AccumulatorStack::Size - 1) {
+                refreshFromCache(position, perspective, accumulator);
+                accumulator.key[perspective] = st->positionKey;
+                return;
+            }
+
+            state = state->previous;
+            ++back;
+        }
+
+        if(!back) {
+            return;
+        }
+
+        Square kingSquare = position.getPosition(KING, perspective);
+        int16_t* values = accumulator.values[perspective];
+
+        std::memcpy(values, stack[position.getPly() - back].values[perspective], sizeof(accumulator.values[perspective]));
+
+        for(const StateInfo* changed = st; changed != state; changed = changed->previous) {
+            const NNUE::DirtyPiece& dirtyPiece = changed->dirtyPiece;
+
+            for(int i = 0; i < dirtyPiece.count; ++i) {
+                Piece piece = dirtyPiece.piece[i];
+
+                if((piece & 7) == KING) {
+                    continue;
+                }
+                if(dirtyPiece.from[i] != NO_SQUARE) {
+                    updateColumn<false>(values, column(perspective, kingSquare, piece, dirtyPiece.from[i]));
+                }
+                if(dirtyPiece.to[i] != NO_SQUARE) {
+                    updateColumn<true>(values, column(perspective, kingSquare, piece, dirtyPiece.to[i]));
+                }
+            }
+        }
+
+        accumulator.key[perspective] = st->positionKey;
+    }
+}
+
+bool NNUE::load(const std::string& fileName) {
+    std::ifstream stream(fileName, std::ios::binary);
+    std::unique_ptr<Network> loading(new Network);
+
+    if(readHeader(stream) != Version) {
+        return false;
+    }
+
+    readHeader(stream); // Hash of the architecture
+    std::string description(readHeader(stream), '\0');
+    stream.read(&description[0], description.size());
+
+    readHeader(stream); // Hash of the feature transformer
+    stream.read(reinterpret_cast<char*>(loading->transformerBiases), sizeof(loading->transformerBiases));
+    stream.read(reinterpret_cast<char*>(loading->transformerWeights.data()), loading->transformerWeights.size() * sizeof(int16_t));
+
+    readHeader(stream); // Hash of the layers
+    if(!loading->hidden1.read(stream)
+        || !loading->hidden2.read(stream)
+        || !loading->output.read(stream)
+        || stream.peek() != std::ifstream::traits_type::eof()) {
+        return false;
+    }
+
+    kernels = TierKernels[CPU::tier()];
+    network = std::move(loading);
+    ++networkId;
+    return true;
+}
+
+bool NNUE::loaded() {
+    return network != nullptr;
+}
+
+bool NNUE::enabled() {
+    return useNetwork;
+}
+
+void NNUE::setEnabled(bool enable) {
+    useNetwork = enable && loaded();
+}
+
+Value NNUE::evaluate(const Position& position) {
+    const Accumulator& accumulator = currentAccumulator(position);
+
+    resolve(position, WHITE);
+    resolve(position, BLACK);
+
+    // The side to move always comes first
+    alignas(64) uint8_t transformed[TransformedDimensions];
+    Colour perspectives[COLOUR_COUNT] = { position.getSide(), ~position.getSide() };
+
+    for(int p = 0; p < COLOUR_COUNT; ++p) {
+        for(int j = 0; j < HalfDimensions; ++j) {
+            transformed[p * HalfDimensions + j] = uint8_t(std::clamp(int(accumulator.values[perspectives[p]][j]), 0, 127));
+        }
+    }
+
+    alignas(64) int32_t hiddenOutput[HiddenDimensions];
+    alignas(64) uint8_t hiddenInput[HiddenDimensions];
+    alignas(64) uint8_t outputInput[HiddenDimensions];
+    int32_t output;
+
+    network->hidden1.propagate(transformed, hiddenOutput);
+    clippedReLU<HiddenDimensions>(hiddenOutput, hiddenInput);
+    network->hidden2.propagate(hiddenInput, hiddenOutput);
+    clippedReLU<HiddenDimensions>(hiddenOutput, outputInput);
+    network->output.propagate(outputInput, &output);
+
+    return Value(std::clamp(output / OutputScale, int(VALUE_MATED_IN_MAX_PLY) + 1, int(VALUE_MATE_IN_MAX_PLY) - 1));
+}
+
+bool NNUE::verify(const Position& position) {
+    const Accumulator& accumulator = currentAccumulator(position);
+    Accumulator fresh;
+
+    resolve(position, WHITE);
+    resolve(position, BLACK);
+
+    refresh(position, WHITE, fresh);
+    refresh(position, BLACK, fresh);
+
+    return !std::memcmp(fresh.values, accumulator.values, sizeof(fresh.values));
+}
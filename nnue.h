@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "defines.h"
+
+class Position;
+
+// Efficiently updatable network in the HalfKP layout of Stockfish 12, so its nets can
+// be loaded as they are. Each side sees every non-king piece relative to its own king,
+// and the first layer keeps a running sum of the active features for both sides.
+namespace NNUE {
+
+    constexpr int HalfDimensions = 256;
+
+    // The pieces a move put down or picked up, so the accumulator can be brought up
+    // to date without looking at the rest of the board. A square of NO_SQUARE means
+    // the piece appeared or disappeared.
+    struct DirtyPiece {
+        int count;
+        Piece piece[3];
+        Square from[3];
+        Square to[3];
+    };
+
+    // Filled in lazily, one side at a time, when a position is evaluated. Each side keeps
+    // the key of the position it was built for.
+    struct Accumulator {
+        alignas(64) int16_t values[COLOUR_COUNT][HalfDimensions];
+        Key key[COLOUR_COUNT];
+    };
+
+    // One accumulator per ply for each thread, shared by every position the thread works
+    // on. Moves do not touch it. An entry only counts for a position with the key it was
+    // built for, so whatever another position left behind is simply built again.
+    struct AccumulatorStack {
+        static constexpr int Size = 256;
+
+        Accumulator& operator[](int ply) { return entries[ply & (Size - 1)]; }
+
+        Accumulator entries[Size];
+        int network = -1;
+    };
+
+    // The last accumulator built for each king square, together with the pieces it
+    // was built for. After a king move only the pieces that differ from the cached
+    // board have to be applied, instead of every piece on the board.
+    struct RefreshEntry {
+        alignas(64) int16_t values[HalfDimensions];
+        Bitboard pieces[COLOUR_COUNT][PIECE_TYPE_COUNT];
+    };
+
+    struct RefreshCache {
+        RefreshEntry entries[SQUARE_COUNT][COLOUR_COUNT];
+        int network = -1;
+    };
+
+    bool load(const std::string& fileName);
+    bool loaded();
+    bool enabled();
+    void setEnabled(bool enable);
+
+    Value evaluate(const Position& position);
+
+    // Whether the accumulator of the current state matches one built from the board
+    bool verify(const Position& position);
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+
+#include "bitboard.h"
+#include "pawns.h"
+#include "thread.h"
+#include "tune.h"
+
+namespace {
+
+    const Score& term(const Score& weight, Colour colour, Tune::Trace* trace, double count = 1) {
+        if(trace) {
+            trace->add(weight, colour, count);
+        }
+
+        return weight;
+    }
+
+    template<Colour us>
+    Score evaluate(const Position& position, Pawns::Entry* entry, Tune::Trace* trace) {
+        constexpr Colour them = ~us;
+        constexpr Direction relativeNorth = us == WHITE ? NORTH : SOUTH;
+        constexpr Direction relativeSouth = us == WHITE ? SOUTH : NORTH;
+        constexpr Direction relativeNorthEast = us == WHITE ? NORTH_EAST : SOUTH_EAST;
+        constexpr Direction relativeNorthWest = us == WHITE ? NORTH_WEST : SOUTH_WEST;
+
+        Score score;
+
+        Bitboard ourPawns = position.getBitboard(PAWN, us);
+        Bitboard enemyPawns = position.getBitboard(PAWN, them);
+
+        entry->passed[us] = 0;
+        entry->blocked[us] = shift((shift(ourPawns, relativeNorth) & enemyPawns), relativeSouth);
+        entry->attacks[us] = shift(ourPawns, relativeNorthEast) | shift(ourPawns, relativeNorthWest);
+
+        Bitboard pawnOptions = ourPawns;
+
+        while(pawnOptions) {
+            Square pawn = popLsb(pawnOptions);
+
+            if(relativeBoard(us, lookups::getNorth(relativeSquare(us, pawn))) & ourPawns) {
+                score += term(doubledPawn, us, trace);
+            }
+            else if(!(relativeBoard(us, lookups::getPassedPawnMask(relativeSquare(us, pawn))) & enemyPawns)) {
+                entry->passed[us] ^= bitShift(pawn);
+            }
+
+            if(!(lookups::adjacent_files(pawn) & ourPawns)) {
+                score += term(isolatedPawn, us, trace);
+            }
+        }
+
+        return score;
+    }
+}
+
+Pawns::Entry* Pawns::probe(const Position& position, Tune::Trace* trace) {
+    Key key = position.getPawnKey();
+    Entry* entry = position.getThread()->pawnsTable[key];
+
+    if(entry->key == key && !trace) {
+        return entry;
+    }
+
+    entry->key = key;
+    entry->kingSquares[WHITE] = entry->kingSquares[BLACK] = NO_SQUARE;
+    entry->scores[WHITE] = evaluate<WHITE>(position, entry, trace);
+    entry->scores[BLACK] = evaluate<BLACK>(position, entry, trace);
+
+    return entry;
+}
+
+Score Pawns::Entry::shelterScore(const Position& position, Colour colour, Square kingSquare, Tune::Trace* trace) const {
+    Score score;
+
+    Colour us = colour;
+    Colour them = ~us;
+
+    Bitboard ourPawns = position.getBitboard(PAWN, us);
+    Bitboard theirPawns = position.getBitboard(PAWN, them);
+
+    for(File file = File(std::max(0, int(getFile(kingSquare)) - 1)); file <= std::min(int(FILE_H), int(getFile(kingSquare)) + 1); ++file) {
+        Bitboard ourPawn = ourPawns & lookups::fileMask(file);
+        int ourRank = !ourPawn ? 0 : relativeRank(us, relativeFirstBit(them, ourPawn));
+
+        uint64_t theirPawn = theirPawns & lookups::fileMask(file);
+        int theirRank = !theirPawn ? 0 : relativeRank(us, relativeFirstBit(them, theirPawn));
+
+        int edgeDist = edgeDistance(file);
+        score += term(pawnShelter[edgeDist][ourRank], us, trace, 0.5) / 2;
+
+        if(ourRank && (ourRank == (theirRank - 1))) {
+            score -= term(blockedPawnStorm[theirRank], us, trace, -0.5) / 2;
+        }
+        else {
+            score -= term(unblockedPawnStorm[edgeDist][theirRank], us, trace, -0.5) / 2;
+        }
+    }
+
+    return score;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "defines.h"
+#include "evaluate.h"
+#include "position.h"
+#include "utils.h"
+
+namespace Pawns {
+
+    // What the evaluation works out from the pawns alone. The pawn structure rarely
+    // changes between neighbouring nodes, so entries are looked up by the pawn key.
+    struct Entry {
+        Score pawnScore(Colour colour) const { return scores[colour]; }
+        Bitboard pawnAttacks(Colour colour) const { return attacks[colour]; }
+        Bitboard passedPawns(Colour colour) const { return passed[colour]; }
+        Bitboard blockedPawns(Colour colour) const { return blocked[colour]; }
+
+        // The shelter also depends on where the king is, so it is worked out again
+        // only when the king has moved since the last call
+        Score kingShelter(const Position& position, Colour colour) {
+            Square kingSquare = position.getPosition(KING, colour);
+
+            if(kingSquares[colour] != kingSquare) {
+                kingSquares[colour] = kingSquare;
+                shelter[colour] = shelterScore(position, colour, kingSquare);
+            }
+
+            return shelter[colour];
+        }
+
+        Score shelterScore(const Position& position, Colour colour, Square kingSquare, Tune::Trace* trace = nullptr) const;
+
+        Key key;
+        Score scores[COLOUR_COUNT];
+        Bitboard passed[COLOUR_COUNT];
+        Bitboard attacks[COLOUR_COUNT];
+        Bitboard blocked[COLOUR_COUNT];
+        Square kingSquares[COLOUR_COUNT];
+        Score shelter[COLOUR_COUNT];
+    };
+
+    typedef HashTable<Entry, 16384> Table;
+
+    // With a trace the entry is always worked out again, so the tuner sees every weight
+    Entry* probe(const Position& position, Tune::Trace* trace = nullptr);
+}
@@ -0,0 +1,247 @@
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "movegen.h"
+#include "perft.h"
+#include "position.h"
+#include "search.h"
+#include "thread.h"
+#include "uci.h"
+#include "utils.h"
+
+namespace {
+
+    // Entries are written without locks. The check word holds the key xor the count, so
+    // an entry torn by two threads writing at once reads as a miss, never as a bad count.
+    struct PerftEntry {
+        std::atomic<Key> check;
+        std::atomic<uint64_t> count;
+    };
+
+    std::unique_ptr<PerftEntry[]> table;
+    size_t entryCount = 0;
+
+    std::atomic<size_t> nextRootMove;
+    std::vector<uint64_t> rootCounts;
+
+    struct SuiteEntry {
+        std::string fen;
+        std::vector<std::pair<int, uint64_t>> expected;
+
+        uint64_t nodes = 0;
+        TimePoint time = 0;
+        bool failed = false;
+    };
+
+    std::vector<SuiteEntry> suite;
+    std::atomic<size_t> nextSuiteEntry;
+
+    // The same position is met at different remaining depths, so the depth is part of the key
+    Key depthKey(Key key, Depth depth) {
+        return key ^ (Key(depth) * 0x9E3779B97F4A7C15ULL);
+    }
+
+    bool probe(Key key, Depth depth, uint64_t& count) {
+        Key k = depthKey(key, depth);
+        PerftEntry& entry = table[k & (entryCount - 1)];
+
+        uint64_t stored = entry.count.load(std::memory_order_relaxed);
+
+        if((entry.check.load(std::memory_order_relaxed) ^ stored) != k) {
+            return false;
+        }
+
+        count = stored;
+        return true;
+    }
+
+    void store(Key key, Depth depth, uint64_t count) {
+        Key k = depthKey(key, depth);
+        PerftEntry& entry = table[k & (entryCount - 1)];
+
+        entry.count.store(count, std::memory_order_relaxed);
+        entry.check.store(k ^ count, std::memory_order_relaxed);
+    }
+}
+
+void Perft::resize(size_t mbSize) {
+    size_t newEntryCount = mbSize ? size_t(1) << rbitscan((mbSize * 1024 * 1024) / sizeof(PerftEntry)) : 0;
+
+    if(newEntryCount != entryCount) {
+        entryCount = newEntryCount;
+        table.reset(entryCount ? new PerftEntry[entryCount]() : nullptr);
+    }
+    else {
+        for(size_t i = 0; i < entryCount; ++i) {
+            table[i].check = table[i].count = 0;
+        }
+    }
+}
+
+// Reads EPD lines of the form "<fen> ;D1 20 ;D2 400 ...". Lines without any expected
+// count are skipped.
+bool Perft::load_suite(const std::string& fileName) {
+    std::ifstream file(fileName);
+    std::string line;
+
+    suite.clear();
+
+    if(!file) {
+        return false;
+    }
+
+    while(std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string field;
+        SuiteEntry entry;
+
+        std::getline(fields, entry.fen, ';');
+
+        while(std::getline(fields, field, ';')) {
+            std::istringstream is(field);
+            std::string depth;
+            uint64_t count;
+
+            if(is >> depth >> count && depth.size() > 1 && (depth[0] == 'D' || depth[0] == 'd')) {
+                entry.expected.emplace_back(std::stoi(depth.substr(1)), count);
+            }
+        }
+
+        if(!entry.expected.empty()) {
+            suite.push_back(entry);
+        }
+    }
+
+    return true;
+}
+
+void Perft::start(size_t rootMoveCount) {
+    nextRootMove = nextSuiteEntry = 0;
+    rootCounts.assign(rootMoveCount, 0);
+}
+
+// Leaves are counted in bulk from the size of the legal move list at depth 1
+uint64_t Perft::count(Position& position, Depth depth) {
+    if(depth <= DEPTH_ZERO) {
+        return 1;
+    }
+
+    ExtMove moveList[MAX_MOVES];
+    uint64_t leaves = 0;
+
+    if(depth > ONE_PLY && entryCount && probe(position.getPositionKey(), depth, leaves)) {
+        return leaves;
+    }
+
+    int size = generateLegalMoves(position, moveList);
+
+    if(depth == ONE_PLY) {
+        return size;
+    }
+
+    StateInfo state;
+    for(int i = 0; i < size; ++i) {
+        position.makeMove(&state, moveList[i]);
+        leaves += count(position, depth - ONE_PLY);
+        position.undoMove(moveList[i]);
+    }
+
+    if(entryCount) {
+        store(position.getPositionKey(), depth, leaves);
+    }
+
+    return leaves;
+}
+
+namespace {
+
+    // The main thread's key history belongs to the UCI position, so it is restored afterwards
+    void run_suite(Thread& thread) {
+        Position& position = thread.rootPos;
+        KeyHistory history = thread.keyHistory;
+
+        for(size_t i = nextSuiteEntry++; i < suite.size(); i = nextSuiteEntry++) {
+            SuiteEntry& entry = suite[i];
+            std::ostringstream failures;
+            TimePoint start = now();
+
+            position.init(entry.fen, &thread);
+
+            for(auto& expected : entry.expected) {
+                if(expected.first > Search::Limits.perft) {
+                    continue;
+                }
+
+                uint64_t nodes = Perft::count(position, Depth(expected.first));
+                entry.nodes += nodes;
+
+                if(nodes != expected.second) {
+                    entry.failed = true;
+                    failures << " D" << expected.first << " " << nodes << " expected " << expected.second;
+                }
+            }
+
+            entry.time = now() - start + 1;
+
+            sync_cout << "info string perftsuite " << i + 1 << "/" << suite.size()
+                << (entry.failed ? " FAILED" : " ok") << " nodes " << entry.nodes << " time " << entry.time
+                << " nps " << entry.nodes * 1000 / entry.time << failures.str()
+                << (entry.failed ? " fen " + entry.fen : "") << sync_endl;
+        }
+
+        thread.keyHistory = history;
+    }
+}
+
+void Perft::search(Thread& thread) {
+    if(!suite.empty()) {
+        return run_suite(thread);
+    }
+
+    Position& position = thread.rootPos;
+    Depth depth = Depth(Search::Limits.perft);
+    StateInfo state;
+
+    for(size_t i = nextRootMove++; i < thread.rootMoves.size(); i = nextRootMove++) {
+        Move move = thread.rootMoves[i].pv[0];
+
+        position.makeMove(&state, move);
+        rootCounts[i] = count(position, depth - ONE_PLY);
+        position.undoMove(move);
+    }
+}
+
+void Perft::report(const Thread& mainThread) {
+    uint64_t total = 0;
+
+    if(!suite.empty()) {
+        size_t failed = 0;
+
+        for(const SuiteEntry& entry : suite) {
+            failed += entry.failed;
+            total += entry.nodes;
+        }
+
+        TimePoint elapsed = now() - Search::Limits.startTime + 1;
+
+        sync_cout << "info string perftsuite positions " << suite.size() << " failed " << failed
+            << " nodes " << total << " time " << elapsed << " nps " << total * 1000 / elapsed << sync_endl;
+
+        suite.clear();
+        return;
+    }
+
+    for(size_t i = 0; i < rootCounts.size(); ++i) {
+        sync_cout << UCI::move(mainThread.rootMoves[i].pv[0]) << ": " << rootCounts[i] << sync_endl;
+        total += rootCounts[i];
+    }
+
+    TimePoint elapsed = now() - Search::Limits.startTime + 1;
+
+    sync_cout << "info string perft depth " << Search::Limits.perft << " nodes " << total
+        << " time " << elapsed << " nps " << total * 1000 / elapsed << sync_endl;
+    sync_cout << total << sync_endl;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "defines.h"
+
+class Position;
+class Thread;
+
+namespace Perft {
+
+    // Perft runs through the thread pool with Search::Limits.perft set to the depth. The
+    // root moves are handed out one at a time to whichever thread is free. With a suite
+    // loaded whole positions are handed out instead, and Limits.perft caps their depth.
+    void resize(size_t mbSize);
+    bool load_suite(const std::string& fileName);
+    void start(size_t rootMoveCount);
+    void search(Thread& thread);
+    void report(const Thread& mainThread);
+
+    uint64_t count(Position& position, Depth depth);
+}
@@ -18,30 +18,49 @@ namespace Zobrist {
 	Key castling[ALL_CASTLING];
 	Key side;
 	Key exclusion;
+	Key noPawns;
 }
 
-Key Position::getExclusionKey() const { return positionKey ^ Zobrist::exclusion; }
+namespace {
+
+	// Keys and moves of every reversible piece move, so that a position one move away
+	// from an earlier one can be found by xoring the two keys and looking the result up.
+	// Both directions of a move share an entry, and each key has two possible slots.
+	Key cuckoo[8192];
+	Move cuckooMove[8192];
+
+	inline int cuckooH1(Key key) { return key & 0x1fff; }
+	inline int cuckooH2(Key key) { return (key >> 16) & 0x1fff; }
+}
+
+Key Position::getExclusionKey() const { return st->positionKey ^ Zobrist::exclusion; }
+
+Position::Position(const Position& pos, Thread* thread) {
+	*this = pos;
+	thisThread = thread;
+	keyHistory = &thread->keyHistory;
+}
 
 Position& Position::operator=(const Position& pos) {
-	std::memcpy(this, &pos, sizeof(Position));
-	nodes = 0;
+	static_cast<BoardState&>(*this) = pos;
+	rootState = *pos.st;
+	rootState.previous = nullptr;
+	st = &rootState;
 
 	return *this;
 }
 
-void Position::init(std::string fen, Thread* thread) {
-	clear();
-
+void Zobrist::init() {
 	for(Piece piece : Pieces) {
 		for(int square = A1; square <= H8; ++square) {
-			Zobrist::psq[piece][square] = utils::rand_u64(0, UINT64_MAX);
+			psq[piece][square] = utils::rand_u64(0, UINT64_MAX);
 		}
 	}
 	for(int file = FILE_A; file <= FILE_H; ++file) {
-		Zobrist::enpassant[file] = utils::rand_u64(0, UINT64_MAX);
+		enpassant[file] = utils::rand_u64(0, UINT64_MAX);
 	}
 	for(int castleRight = NO_CASTLING; castleRight < ALL_CASTLING; ++castleRight) {
-		Zobrist::castling[castleRight] = utils::rand_u64(0, UINT64_MAX);
+		castling[castleRight] = utils::rand_u64(0, UINT64_MAX);
 	}
 
 	for(Square square = A1; square < SQUARE_COUNT; ++square) {
@@ -54,12 +73,51 @@ void Position::init(std::string fen, Thread* thread) {
 	castling::castlingRightsMask[E8] = 3;
 	castling::castlingRightsMask[H8] = 11;
 
+	side = utils::rand_u64(0, UINT64_MAX);
+	exclusion = utils::rand_u64(0, UINT64_MAX);
+	noPawns = utils::rand_u64(0, UINT64_MAX);
+
+	int count = 0;
+	for(Piece piece : Pieces) {
+		for(Square s1 = A1; s1 <= H8; ++s1) {
+			for(Square s2 = Square(s1 + 1); s2 <= H8; ++s2) {
+				PieceType type = PieceType(piece & 7);
+
+				if(type == PAWN || !(lookups::attacks(type, s1, 0) & bitShift(s2))) {
+					continue;
+				}
+
+				Move move = getMove(s1, s2);
+				Key key = psq[piece][s1] ^ psq[piece][s2] ^ side;
+				int i = cuckooH1(key);
+
+				while(true) {
+					std::swap(cuckoo[i], key);
+					std::swap(cuckooMove[i], move);
+
+					if(move == NO_MOVE) {
+						break;
+					}
+
+					i = (i == cuckooH1(key)) ? cuckooH2(key) : cuckooH1(key);
+				}
+				++count;
+			}
+		}
+	}
+	assert(count == 3668);
+}
+
+// The keys are generated once at startup so that TT entries stay valid from one
+// "position" command to the next
+void Position::init(std::string fen, Thread* thread) {
+	clear();
 
-	Zobrist::side = utils::rand_u64(0, UINT64_MAX);
-	Zobrist::exclusion = utils::rand_u64(0, UINT64_MAX);
-	std::fill(std::begin(prevPositionKey), std::end(prevPositionKey), 0);
 	thisThread = thread;
+	keyHistory = &thread->keyHistory;
+	keyHistory->clear();
 	parseFen(fen);
+	keyHistory->push(st->positionKey);
 }
 
 void Position::clear() {
@@ -72,10 +130,10 @@ void Position::clear() {
 	for(int i = 0; i < 64; ++i) {
 		board[i] = NO_PIECE;
 	}
-	enPassantSquare = NO_SQUARE;
-	castlingRights = 0;
 	ply = 0;
-	positionKey = 0;
+	psqScore = Score();
+	rootState = StateInfo();
+	st = &rootState;
 }
 
 void Position::parseFen(std::string fenString) {
@@ -128,10 +186,10 @@ void Position::parseFen(std::string fenString) {
 	// Iterate through the castling permissions and set the correct bit for each permission available
 	while((stream >> token) && !isspace(token)) {
 		switch(token) {
-		case('K'): castlingRights |= WHITE_OO;  break;
-		case('Q'): castlingRights |= WHITE_OOO; break;
-		case('k'): castlingRights |= BLACK_OO;  break;
-		case('q'): castlingRights |= BLACK_OOO; break;
+		case('K'): st->castlingRights |= WHITE_OO;  break;
+		case('Q'): st->castlingRights |= WHITE_OOO; break;
+		case('k'): st->castlingRights |= BLACK_OO;  break;
+		case('q'): st->castlingRights |= BLACK_OOO; break;
 		}
 	}
 	// Go past whitespace
@@ -141,15 +199,18 @@ void Position::parseFen(std::string fenString) {
 		stream >> token;
 		int rank = token - '1';
 
-		enPassantSquare = Square(file + rank * 8);
+		st->enPassantSquare = Square(file + rank * 8);
 	}
 
-	stream >> std::skipws >> fiftyMoveCount;
+	stream >> std::skipws >> st->fiftyMoveCount;
 	int totalMoves = 0;
 	stream >> totalMoves;
 	totalMoves = std::max(2 * (totalMoves - 1), 0) + side;
 	ply = totalMoves;
-	this->positionKey = generatePositionKey();
+	st->positionKey = generatePositionKey();
+	st->pawnKey = generatePawnKey();
+	st->materialKey = generateMaterialKey();
+	setCheckInfo();
 }
 
 void Position::display() const {
@@ -192,64 +253,138 @@ bool Position::checkPassedPawn(Square square) const {
 		&& !(lookups::getNorth(square) & getBitboard(PAWN, side));
 }
 
-Bitboard Position::pinned(Colour side) const {
-	Colour them = ~side;
+// Pieces of either colour that are the only thing between a slider in sliders and the
+// given square. Those belonging to the square's side are pinned, and their pinners are
+// returned through the pinners argument.
+Bitboard Position::sliderBlockers(Bitboard sliders, Square square, Bitboard& pinners) const {
+	Bitboard blockers = 0;
+	pinners = 0;
 
-	Square kingSquare = getPosition(KING, side);
-	Bitboard occupied = getOccupied();
 	Bitboard queen = getBitboard(QUEEN);
-	Bitboard rookQueen = getBitboard(ROOK) | queen;
-	Bitboard bishopQueen = getBitboard(BISHOP) | queen;
-	Bitboard opponent = getBitboardColour(them);
+	Bitboard snipers = ((lookups::rook(square) & (getBitboard(ROOK) | queen))
+		| (lookups::bishop(square) & (getBitboard(BISHOP) | queen))) & sliders;
+	Bitboard occupancy = getOccupied() ^ snipers;
+
+	while(snipers) {
+		Square sniperSquare = popLsb(snipers);
+		Bitboard board = lookups::intervening_sqs(square, sniperSquare) & occupancy;
+
+		if(board && !(board & (board - 1))) {
+			blockers |= board;
+			if(board & getBitboardColour(getPieceColour(getPieceOnSquare(square)))) {
+				pinners |= bitShift(sniperSquare);
+			}
+		}
+	}
 
-	Bitboard pinners = (rookQueen & opponent & lookups::rook(kingSquare))
-		| (bishopQueen & opponent & lookups::bishop(kingSquare));
-	Bitboard pinned = 0;
+	return blockers;
+}
+
+// Called whenever the side to move changes. pinners[c] holds the pieces of colour c
+// pinning an enemy piece to its king, and checkSquares[pt] the squares from which a
+// piece of type pt would give check.
+void Position::setCheckInfo() {
+	Colour us = side;
+	Colour them = ~us;
+	Square kingSquare = getPosition(KING, them);
+	Bitboard occupied = getOccupied();
 
-	while(pinners) {
-		Square square = popLsb(pinners);
-		Bitboard board = lookups::intervening_sqs(square, kingSquare) & occupied;
+	CheckInfo& checkInfo = st->checkInfo;
 
-		if(!(board & (board - 1))) {
-			pinned ^= board & getBitboardColour(side);
-		}
-	}
+	checkInfo.checkers = attackersTo(getPosition(KING, us), them);
+	checkInfo.blockersForKing[WHITE] = sliderBlockers(getBitboardColour(BLACK), getPosition(KING, WHITE), checkInfo.pinners[BLACK]);
+	checkInfo.blockersForKing[BLACK] = sliderBlockers(getBitboardColour(WHITE), getPosition(KING, BLACK), checkInfo.pinners[WHITE]);
 
-	return pinned;
+	checkInfo.checkSquares[PAWN] = lookups::pawn(kingSquare, them);
+	checkInfo.checkSquares[KNIGHT] = lookups::knight(kingSquare);
+	checkInfo.checkSquares[BISHOP] = lookups::bishop(kingSquare, occupied);
+	checkInfo.checkSquares[ROOK] = lookups::rook(kingSquare, occupied);
+	checkInfo.checkSquares[QUEEN] = checkInfo.checkSquares[BISHOP] | checkInfo.checkSquares[ROOK];
+	checkInfo.checkSquares[KING] = 0;
 }
 
-bool Position::checkLegality(Move move) const {
-	Colour us = getSide();
+// Tests a move that did not come from the generator, e.g. the TT move or a killer, for
+// being possible in this position. Legality is left to checkLegality.
+bool Position::checkPseudoLegal(Move move) const {
+	Colour us = side;
 	Colour them = ~us;
 
 	Square from = getFrom(move);
 	Square to = getTo(move);
-	Square kingSquare = getPosition(KING, us);
+	Piece fromPiece = getPieceOnSquare(from);
 
-	Bitboard occupied = getOccupied();
+	if(!isValidMove(move)) {
+		return false;
+	}
 
-	if(getPieceOnSquare(from) == NO_PIECE || getPieceColour(getPieceOnSquare(from)) != us) {
+	// Special moves are rare enough to just be looked up in the legal move list
+	if(getMoveType(move) != NORMAL) {
+		ExtMove moveList[MAX_MOVES];
+		ExtMove* end = generate<LEGAL>(*this, moveList);
+
+		return std::find(moveList, end, move) != end;
+	}
+
+	if(getPromotionType(move) != PROMOTE_NONE) {
 		return false;
 	}
-	if(getPieceOnSquare(to) != NO_PIECE && getPieceColour(getPieceOnSquare(to)) == us) {
+
+	if(fromPiece == NO_PIECE || getPieceColour(fromPiece) != us) {
 		return false;
 	}
-	if(getPieceType(getPieceOnSquare(to)) == KING) {
+
+	if(getBitboardColour(us) & bitShift(to)) {
 		return false;
 	}
 
-	if(getMoveType(move) == ENPASSANT) {
-		if(side == WHITE && getRank(enPassantSquare) != RANK_5) {
+	if(getPieceType(fromPiece) == PAWN) {
+		// Promotions were handled above
+		if((RANK_8_MASK | RANK_1_MASK) & bitShift(to)) {
+			return false;
+		}
+
+		Direction up = pawnPush(us);
+		Bitboard vacant = ~getOccupied();
+
+		if(!(lookups::pawn(from, us) & getBitboardColour(them) & bitShift(to))
+			&& !(from + up == to && (vacant & bitShift(to)))
+			&& !(from + 2 * up == to && relativeRank(us, from) == RANK_2
+				&& (vacant & bitShift(to)) && (vacant & bitShift(to - up)))) {
+			return false;
+		}
+	}
+	else if(!(lookups::attacks(getPieceType(fromPiece), from, getOccupied()) & bitShift(to))) {
+		return false;
+	}
+
+	// Evasions have to capture the checker or block it, the king is tested in checkLegality
+	if(getCheckers() && getPieceType(fromPiece) != KING) {
+		Bitboard checkers = getCheckers();
+
+		if(checkers & (checkers - 1)) {
 			return false;
 		}
-		if(side == BLACK && getRank(enPassantSquare) != RANK_4) {
+
+		if(!((lookups::intervening_sqs(fbitscan(checkers), getPosition(KING, us)) | checkers) & bitShift(to))) {
 			return false;
 		}
-		Direction down = -pawnPush(us);
+	}
+
+	return true;
+}
+
+// Assumes a pseudo legal move and tests whether it leaves our king in check
+bool Position::checkLegality(Move move) const {
+	Colour us = getSide();
+	Colour them = ~us;
+
+	Square from = getFrom(move);
+	Square to = getTo(move);
+	Square kingSquare = getPosition(KING, us);
 
-		Bitboard toBoard = bitShift(getEnPassantSquare());
-		Bitboard capture = shift(to, down);
-		Bitboard pieces = (getOccupied() ^ bitShift(from) ^ capture) | toBoard;
+	if(getMoveType(move) == ENPASSANT) {
+		Square captureSquare = to - pawnPush(us);
+		Bitboard pieces = (getOccupied() ^ bitShift(from) ^ bitShift(captureSquare)) | bitShift(to);
 
 		Bitboard queen = getBitboard(QUEEN);
 		Bitboard rookQueen = getBitboard(ROOK) | queen;
@@ -259,29 +394,15 @@ bool Position::checkLegality(Move move) const {
 		return !(lookups::rook(kingSquare, pieces) & (rookQueen & opponent))
 			&& !(lookups::bishop(kingSquare, pieces) & (bishopQueen & opponent));
 	}
+	// Castling is only generated when legal
 	else if(getMoveType(move) == CASTLING) {
-		if(to < from) {
-			for(int square = 0; square <= 2; ++square) {
-				if((bitShift(castling::queenSide[us][square]) & occupied) || attackersTo(castling::queenSide[us][square], them)) {
-					return false;
-				}
-			}
-		}
-		else {
-			for(int square = 0; square <= 1; ++square) {
-				if((bitShift(castling::kingSide[us][square]) & occupied) || attackersTo(castling::kingSide[us][square], them)) {
-					return false;
-				}
-			}
-		}
-
 		return true;
 	}
 	else if(from == kingSquare) {
-		return !attackersTo(to, them);
+		return !attackersTo(to, getOccupied() ^ bitShift(from), them);
 	}
 	else {
-		return !(pinned(us) & bitShift(from)) || (bitShift(to) & lookups::full_ray(from, kingSquare));
+		return !(getBlockersForKing(us) & bitShift(from)) || (bitShift(to) & lookups::full_ray(from, kingSquare));
 	}
 }
 
@@ -291,121 +412,61 @@ bool Position::givesCheck(Move move) const {
 
 	Square from = getFrom(move);
 	Square to = getTo(move);
-	Bitboard bitFrom = bitShift(from);
-	Bitboard bitTo = bitShift(to);
-	PieceType fromPieceType = getPieceType(getPieceOnSquare(from));
-	PieceType toPieceType = getPieceType(getPieceOnSquare(to));
-
-	Bitboard occupied = getOccupied();
-
 	Square enemyKing = getPosition(KING, them);
-	Bitboard pawns = getBitboard(PAWN, us);
-	Bitboard knights = getBitboard(KNIGHT, us);
-	Bitboard bishops = getBitboard(BISHOP, us);
-	Bitboard rooks = getBitboard(ROOK, us);
-	Bitboard queens = getBitboard(QUEEN, us);
-	
-	switch(getMoveType(move)) {
-		case NORMAL: {
-			switch(fromPieceType) {
-				case PAWN:
-					pawns ^= bitFrom;
-					pawns ^= bitTo;
-					break;
-				case KNIGHT:
-					knights ^= bitFrom;
-					knights ^= bitTo;
-					break;
-				case BISHOP:
-					bishops ^= bitFrom;
-					bishops ^= bitTo;
-					break;
-				case ROOK:
-					rooks ^= bitFrom;
-					rooks ^= bitTo;
-					break;
-				case QUEEN:
-					queens ^= bitFrom;
-					queens ^= bitTo;
-					break;
-				case KING:
-					break;
-				default:
-					return false;
-			}
 
-			occupied ^= bitFrom;
-			occupied |= bitTo;
-			break;
-		}
-		case PROMOTION: {
-			occupied ^= bitFrom;
-			pawns ^= bitFrom;
-
-			switch(getPromotionType(move)) {
-				case PROMOTE_TO_KNIGHT: 
-					knights ^= bitTo;
-					break;
-				case PROMOTE_TO_BISHOP:
-					bishops ^= bitTo;
-					break;
-				case PROMOTE_TO_ROOK:
-					rooks ^= bitTo;
-					break;
-				case PROMOTE_TO_QUEEN:
-					queens ^= bitTo;
-					break;
-			}
-			if(toPieceType == NO_PIECE) {
-				occupied ^= bitTo;
-			}
-			break;
-		}
+	// Direct check
+	if(getCheckSquares(getPieceType(getPieceOnSquare(from))) & bitShift(to)) {
+		return true;
+	}
 
-		case ENPASSANT: {
-			occupied ^= bitFrom;
-			pawns ^= bitFrom;
-			pawns ^= bitTo;
+	// Discovered check
+	if((getBlockersForKing(them) & bitShift(from)) && !(lookups::full_ray(from, enemyKing) & bitShift(to))) {
+		return true;
+	}
 
-			occupied ^= bitShift(enPassantSquare);
-			break;
-		}
-		case CASTLING: {
-			Square rookSquare;
-			if(from > to) {
-				rookSquare = us == WHITE ? D1 : D8;
-			}
-			else {
-				rookSquare = us == WHITE ? F1 : F8;
-			}
+	switch(getMoveType(move)) {
+	case NORMAL:
+		return false;
+	case PROMOTION: {
+		PieceType promotion = getPieceType(getPromotion(move));
+		return lookups::attacks(promotion, to, getOccupied() ^ bitShift(from)) & bitShift(enemyKing);
+	}
+	// The captured pawn may have been the only piece shielding the king
+	case ENPASSANT: {
+		Square captureSquare = to - pawnPush(us);
+		Bitboard occupied = (getOccupied() ^ bitShift(from) ^ bitShift(captureSquare)) | bitShift(to);
+		Bitboard queens = getBitboard(QUEEN, us);
 
-			occupied ^= bitShift(rookSquare);
-			return lookups::rook(enemyKing, occupied) & bitShift(rookSquare);
-		}
-		default:
-			assert(false);
-			return false;
+		return (lookups::rook(enemyKing, occupied) & (getBitboard(ROOK, us) | queens))
+			| (lookups::bishop(enemyKing, occupied) & (getBitboard(BISHOP, us) | queens));
 	}
+	case CASTLING: {
+		Square rookFrom = to > from ? to + 1 : to - 2;
+		Square rookTo = to > from ? to - 1 : to + 1;
+		Bitboard occupied = (getOccupied() ^ bitShift(from) ^ bitShift(rookFrom)) | bitShift(to) | bitShift(rookTo);
 
-	return (lookups::rook(enemyKing, occupied) & (rooks | queens))
-		| (lookups::bishop(enemyKing, occupied) & (bishops | queens))
-		| (lookups::knight(enemyKing) & knights)
-		| (lookups::pawn(enemyKing, them) & pawns);
+		return lookups::rook(rookTo, occupied) & bitShift(enemyKing);
+	}
+	default:
+		assert(false);
+		return false;
+	}
 }
 
-void Position::makeMove(Undo* undo, Move move) {
+void Position::makeMove(StateInfo* newState, Move move) {
 	Square from = getFrom(move);
 	Square to = getTo(move);
 	Piece fromPiece = getPieceOnSquare(from);
-	Piece toPiece = getPieceOnSquare(to);
-	
-	undo->positionKey = positionKey;
-	undo->castleRights = castlingRights;
-	undo->fiftyMoveCount = fiftyMoveCount;
-	undo->ply = ply;
-	undo->enpassantSquare = enPassantSquare;
-	undo->captureSquare = to;
-	undo->capturePiece = toPiece;
+	Square captureSquare = getMoveType(move) == ENPASSANT ? to - pawnPush(side) : to;
+	Piece toPiece = getMoveType(move) == CASTLING ? NO_PIECE : getPieceOnSquare(captureSquare);
+
+	static_cast<CopiedState&>(*newState) = *st;
+	newState->previous = st;
+	st = newState;
+	++st->pliesFromNull;
+
+	// Only this thread writes the counter, so a relaxed load and store is enough
+	thisThread->nodes.store(thisThread->nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 
 	// For castling
 	Piece rook = (side == WHITE) ? wR : bR;
@@ -414,10 +475,11 @@ void Position::makeMove(Undo* undo, Move move) {
 	Square queenRook = (side == WHITE) ? A1 : A8;
 	Square kingRook = (side == WHITE) ? H1 : H8;
 
-	castlingRights &= castling::castlingRightsMask[from] & castling::castlingRightsMask[to];
-	enPassantSquare = NO_SQUARE;
+	setCastlingRights(st->castlingRights & castling::castlingRightsMask[from] & castling::castlingRightsMask[to]);
+	setEnPassant(NO_SQUARE);
+	st->capturedPiece = toPiece;
 
-	if(getPieceType(fromPiece) == PAWN) {
+	if(getPieceType(fromPiece) == PAWN || toPiece != NO_PIECE) {
 		resetFiftyMoveCount();
 	}
 	else {
@@ -426,10 +488,6 @@ void Position::makeMove(Undo* undo, Move move) {
 
 	switch(getMoveType(move)) {
 	case NORMAL: {
-		if(checkCapture(move)) {
-			resetFiftyMoveCount();
-		}
-
 		if(getPieceType(fromPiece) == PAWN && ((to ^ from) == 16)) {
 			setEnPassant(Square(to - pawnPush(side)));
 		}
@@ -443,8 +501,7 @@ void Position::makeMove(Undo* undo, Move move) {
 		break;
 	}
 	case ENPASSANT: {
-		Square enPassantee = to - pawnPush(side);
-		removePiece(enPassantee, getPieceOnSquare(enPassantee));
+		removePiece(captureSquare, toPiece);
 		movePiece(from, to);
 		break;
 	}
@@ -469,106 +526,131 @@ void Position::makeMove(Undo* undo, Move move) {
 	}
 	}
 
+	// The material key holds one random number per piece and count, so it only
+	// changes on captures and promotions
+	if(toPiece != NO_PIECE) {
+		st->materialKey ^= Zobrist::psq[toPiece][popCount(getBitboard(toPiece))];
+	}
+	if(getMoveType(move) == PROMOTION) {
+		Piece promotion = getPromotion(move);
+
+		st->materialKey ^= Zobrist::psq[fromPiece][popCount(getBitboard(fromPiece))]
+			^ Zobrist::psq[promotion][popCount(getBitboard(promotion)) - 1];
+	}
+
+	// What the network needs to update its accumulator, the moved piece always first
+	NNUE::DirtyPiece& dirtyPiece = st->dirtyPiece;
+	dirtyPiece.count = 1;
+	dirtyPiece.piece[0] = fromPiece;
+	dirtyPiece.from[0] = from;
+	dirtyPiece.to[0] = to;
+
+	if(toPiece != NO_PIECE) {
+		dirtyPiece.piece[1] = toPiece;
+		dirtyPiece.from[1] = captureSquare;
+		dirtyPiece.to[1] = NO_SQUARE;
+		dirtyPiece.count = 2;
+	}
+	if(getMoveType(move) == PROMOTION) {
+		dirtyPiece.to[0] = NO_SQUARE;
+		dirtyPiece.piece[dirtyPiece.count] = getPromotion(move);
+		dirtyPiece.from[dirtyPiece.count] = NO_SQUARE;
+		dirtyPiece.to[dirtyPiece.count] = to;
+		++dirtyPiece.count;
+	}
+	if(getMoveType(move) == CASTLING) {
+		dirtyPiece.piece[1] = rook;
+		dirtyPiece.from[1] = to == kingSide ? kingRook : queenRook;
+		dirtyPiece.to[1] = to == kingSide ? to - 1 : to + 1;
+		dirtyPiece.count = 2;
+	}
+
 	this->switchSides();
-	positionKey = generatePositionKey();
+	setCheckInfo();
+	assert(st->positionKey == generatePositionKey());
+	assert(st->pawnKey == generatePawnKey());
+	assert(st->materialKey == generateMaterialKey());
+	keyHistory->push(st->positionKey);
 	++ply;
 }
 
-void Position::undoMove(Undo* undo, Move move) {
-
-	switchSides();
-	if(ply > 0) {
-		--ply;
-	}
-	positionKey = undo->positionKey;
-	castlingRights = undo->castleRights;
-	fiftyMoveCount = undo->fiftyMoveCount;
-	enPassantSquare = undo->enpassantSquare;
+void Position::undoMove(Move move) {
+	side = ~side;
+	keyHistory->pop();
 
-	Colour us = getSide();
 	Square to = getTo(move);
 	Square from = getFrom(move);
 	Piece toPiece = getPieceOnSquare(to);
-	
-	if(getMoveType(move) == PROMOTION) {
-		Piece pawn = (getSide() == WHITE) ? wP : bP;
+
+	switch(getMoveType(move)) {
+	case PROMOTION: {
 		removePiece(to, toPiece);
-		placePiece(getFrom(move), pawn);
+		placePiece(from, getSide() == WHITE ? wP : bP);
+		break;
 	}
-	else if(getMoveType(move) == CASTLING) {
-		switch(to) {
-			case C1: {
-				castlingRights |= WHITE_OOO;
-				movePiece(C1, E1);
-				movePiece(D1, A1);
-				break;
+	case CASTLING: {
+		Piece rook = (getSide() == WHITE) ? wR : bR;
+		Square rookFrom = to > from ? to + 1 : to - 2;
+		Square rookTo = to > from ? to - 1 : to + 1;
 
-			}
-			case G1: {
-				castlingRights |= WHITE_OO;
-				movePiece(G1, E1);
-				movePiece(F1, H1);
-				break;
-			}
-			case C8: {
-				castlingRights |= BLACK_OOO;
-				movePiece(C8, E8);
-				movePiece(C8, A8);
-				break;
-			}
-			case G8: {
-				castlingRights |= BLACK_OO;
-				movePiece(G8, E8);
-				movePiece(F8, H8);
-				break;
-			}
-			default: break;
-		}
+		removePiece(to, toPiece);
+		removePiece(rookTo, rook);
+		placePiece(from, toPiece);
+		placePiece(rookFrom, rook);
+		break;
 	}
-	else {
+	default: {
 		movePiece(to, from);
+		break;
+	}
+	}
 
-		if(undo->capturePiece != NO_PIECE) {
-			placePiece(undo->captureSquare, undo->capturePiece);
-		}
+	if(st->capturedPiece != NO_PIECE) {
+		placePiece(getMoveType(move) == ENPASSANT ? to - pawnPush(side) : to, st->capturedPiece);
 	}
+
+	// The piece moves above touched the key, but the previous state has its own
+	st = st->previous;
+	--ply;
 }
 
 bool Position::validateMove(Move move) const {
 	return getPieceColour(getPieceOnSquare(getFrom(move))) == side;
 }
 
-void Position::makeNullMove(Undo* undo) {
-	undo->positionKey = positionKey;
-	undo->fiftyMoveCount = fiftyMoveCount;
-	undo->enpassantSquare = enPassantSquare;
+void Position::makeNullMove(StateInfo* newState) {
+	static_cast<CopiedState&>(*newState) = *st;
+	newState->previous = st;
+	st = newState;
+	st->pliesFromNull = 0;
 
 	incrementFiftyMoveCount();
-	enPassantSquare = NO_SQUARE;
+	setEnPassant(NO_SQUARE);
+	st->capturedPiece = NO_PIECE;
+
+	// Nothing on the board changes, so the accumulator is taken over when it is needed
+	st->dirtyPiece.count = 0;
+	st->dirtyPiece.piece[0] = NO_PIECE;
 	switchSides();
-	positionKey = generatePositionKey();
+	setCheckInfo();
+	assert(st->positionKey == generatePositionKey());
+	keyHistory->push(st->positionKey);
 	++ply;
-	if(enPassantSquare != NO_SQUARE) {
-		positionKey ^= Zobrist::enpassant[getFile(enPassantSquare)];
-		enPassantSquare = NO_SQUARE;
-	}
 }
 
-void Position::undoNullMove(Undo* undo) {
-	switchSides();
-	if(ply > 0) {
-		--ply;
-	}
-	positionKey = undo->positionKey;
-	fiftyMoveCount = undo->fiftyMoveCount;
-	enPassantSquare = undo->enpassantSquare;
+void Position::undoNullMove() {
+	side = ~side;
+	keyHistory->pop();
+
+	st = st->previous;
+	--ply;
 }
 
 Colour Position::getSide() const {
 	return side;
 }
 
-Key Position::generatePositionKey() {
+Key Position::generatePositionKey() const {
 	Key key = Key(0);
 	Piece piece = NO_PIECE;
 
@@ -581,145 +663,192 @@ Key Position::generatePositionKey() {
 		}
 	}
 
-	if(enPassantSquare != NO_SQUARE) {
-		key ^= Zobrist::enpassant[getFile(enPassantSquare)];
+	if(st->enPassantSquare != NO_SQUARE) {
+		key ^= Zobrist::enpassant[getFile(st->enPassantSquare)];
 	}
 
 	key ^= Zobrist::castling[getCastlingRights()];
 
-	prevPositionKey[ply] = key;
+	if(side == BLACK) {
+		key ^= Zobrist::side;
+	}
+
 	return key;
 }
 
-template<int pieceType>
-PieceType minAttacker(const Position* position, Square to, Bitboard sideToMoveAttackers,
-						Bitboard& occupied, Bitboard& attackers) {
+// Independent of where the pieces stand, so positions with the same material share it
+Key Position::generateMaterialKey() const {
+	Key key = Key(0);
 
-	Bitboard b = sideToMoveAttackers & position->getBitboard(PieceType(pieceType));
-	if(!b) {
-		return minAttacker<pieceType + 1>(position, to, sideToMoveAttackers, occupied, attackers);
+	for(Piece piece : Pieces) {
+		for(int count = 0; count < popCount(getBitboard(piece)); ++count) {
+			key ^= Zobrist::psq[piece][count];
+		}
 	}
 
-	occupied ^= b & ~(b - 1);
-
-	if(pieceType == PAWN || pieceType == BISHOP || pieceType == QUEEN) {
-		attackers |= position->attackersTo(to, occupied) & (position->getBitboard(BISHOP) | position->getBitboard(QUEEN));
-	}
+	return key;
+}
 
-	if(pieceType == ROOK || pieceType == QUEEN) {
-		attackers |= position->attackersTo(to, occupied) & (position->getBitboard(ROOK) | position->getBitboard(QUEEN));
-	}
+// Starts from a key of its own, so that a position without pawns does not get key 0 and
+// match an empty entry of the pawn table
+Key Position::generatePawnKey() const {
+	Key key = Zobrist::noPawns;
 
-	attackers &= occupied; // After X-ray that may add already processed pieces
-	return (PieceType)pieceType;
-}
-template<>
-PieceType minAttacker<KING>(const Position*, Square, Bitboard, Bitboard&, Bitboard&) {
-	return KING;
-}
+	for(Piece piece : { wP, bP }) {
+		Bitboard bb = getBitboard(piece);
 
-Value Position::seeSign(Move move) const {
-	if(pieceValue[getPieceOnSquare(getFrom(move))].value() <= pieceValue[getPieceOnSquare(getTo(move))].value()) {
-		return VALUE_KNOWN_WIN;
+		while(bb) {
+			key ^= Zobrist::psq[piece][popLsb(bb)];
+		}
 	}
 
-	return see(move);
+	return key;
 }
 
-Value Position::see(Move move) const {
-	Value swapList[32];
-	int slIndex = 1;
+// Static exchange evaluation in threshold form: does the move win at least threshold
+// once all captures on the destination square are played out? Each side may stop
+// capturing whenever it likes, so the loop can return as soon as the side to move cannot
+// bring the balance back past the threshold.
+bool Position::see_ge(Move move, Value threshold) const {
+	// Only plain moves are worked out, the rest are taken as even exchanges
+	if(getMoveType(move) != NORMAL) {
+		return VALUE_ZERO >= threshold;
+	}
 
 	Square from = getFrom(move);
 	Square to = getTo(move);
-	swapList[0] = Value(pieceValue[getPieceOnSquare(to)].value());
-	Colour sideToMove = getPieceColour(getPieceOnSquare(from));
-	Bitboard occupied  = getOccupied() ^ bitShift(from);
 
-	if(getMoveType(move) == CASTLING) {
-		return VALUE_ZERO;
+	int swap = pieceValue[getPieceType(getPieceOnSquare(to))].value() - threshold;
+	if(swap < 0) {
+		return false;
 	}
 
-	if(getMoveType(move) == ENPASSANT) {
-		occupied ^= bitShift(to - pawnPush(sideToMove));
-		swapList[0] = Value(pieceValue[PAWN].value());
+	swap = pieceValue[getPieceType(getPieceOnSquare(from))].value() - swap;
+	if(swap <= 0) {
+		return true;
 	}
 
-	Bitboard attackers = attackersTo(to, occupied) & occupied;
-
-	sideToMove = ~sideToMove;
-	Bitboard sideToMoveAttackers = attackers & getBitboardColour(sideToMove);
-	if(!sideToMoveAttackers) {
-		return swapList[0];
-	}
+	Bitboard occupied = getOccupied() ^ bitShift(from) ^ bitShift(to);
+	Colour sideToMove = getPieceColour(getPieceOnSquare(from));
+	Bitboard attackers = attackersTo(to, occupied);
+	Bitboard bishops = getBitboard(BISHOP) | getBitboard(QUEEN);
+	Bitboard rooks = getBitboard(ROOK) | getBitboard(QUEEN);
+	Bitboard sideToMoveAttackers, bb;
+	int result = 1;
 
-	PieceType captured = getPieceType(getPieceOnSquare(from));
+	while(true) {
+		sideToMove = ~sideToMove;
+		attackers &= occupied;
 
-	do {
-		assert(slIndex < 32);
+		if(!(sideToMoveAttackers = attackers & getBitboardColour(sideToMove))) {
+			break;
+		}
 
-		swapList[slIndex] = -swapList[slIndex - 1] + pieceValue[captured].value();
+		// Pinned pieces may not capture while their pinner is still on the board
+		if(getPinners(~sideToMove) & occupied) {
+			sideToMoveAttackers &= ~getBlockersForKing(sideToMove);
 
-		captured = minAttacker<PAWN>(this, to, sideToMoveAttackers, occupied, attackers);
-		sideToMove = ~sideToMove;
-		sideToMoveAttackers = attackers & getBitboardColour(sideToMove);
-		++slIndex;
+			if(!sideToMoveAttackers) {
+				break;
+			}
+		}
 
-	} while(sideToMoveAttackers && (captured != KING || (--slIndex, false)));
+		result ^= 1;
 
-	while(--slIndex) {
-		swapList[slIndex - 1] = std::min(-swapList[slIndex], swapList[slIndex - 1]);
+		// Capture with the least valuable attacker, uncovering any x-ray attackers behind it
+		if((bb = sideToMoveAttackers & getBitboard(PAWN))) {
+			if((swap = pieceValue[PAWN].value() - swap) < result) {
+				break;
+			}
+			occupied ^= bb & -bb;
+			attackers |= lookups::bishop(to, occupied) & bishops;
+		}
+		else if((bb = sideToMoveAttackers & getBitboard(KNIGHT))) {
+			if((swap = pieceValue[KNIGHT].value() - swap) < result) {
+				break;
+			}
+			occupied ^= bb & -bb;
+		}
+		else if((bb = sideToMoveAttackers & getBitboard(BISHOP))) {
+			if((swap = pieceValue[BISHOP].value() - swap) < result) {
+				break;
+			}
+			occupied ^= bb & -bb;
+			attackers |= lookups::bishop(to, occupied) & bishops;
+		}
+		else if((bb = sideToMoveAttackers & getBitboard(ROOK))) {
+			if((swap = pieceValue[ROOK].value() - swap) < result) {
+				break;
+			}
+			occupied ^= bb & -bb;
+			attackers |= lookups::rook(to, occupied) & rooks;
+		}
+		else if((bb = sideToMoveAttackers & getBitboard(QUEEN))) {
+			if((swap = pieceValue[QUEEN].value() - swap) < result) {
+				break;
+			}
+			occupied ^= bb & -bb;
+			attackers |= (lookups::bishop(to, occupied) & bishops) | (lookups::rook(to, occupied) & rooks);
+		}
+		// The king may only capture if the opponent has nothing left to recapture with
+		else {
+			return (attackers & ~getBitboardColour(sideToMove)) ? result ^ 1 : result;
+		}
 	}
 
-	return swapList[0];
+	return bool(result);
 }
 
-bool Position::checkRepetition() const {
-	Key currentKey = getPositionKey();
-
+// ply is the number of moves played since the root. A position repeated after the root is
+// a draw straight away, one from the game before it only when it occurs for the third
+// time. Nothing repeats across a capture, a pawn move or a null move, so the scan stops at
+// whichever came last.
+bool Position::checkRepetition(int ply) const {
+	int last = keyHistory->size() - 1;
+	int end = std::min({ st->fiftyMoveCount, st->pliesFromNull, last });
 	int repetitions = 0;
-	for(int i = ply - 2; i >= 0; i -= 2) {
-		if(prevPositionKey[i] == currentKey) {
-			++repetitions;
+
+	for(int i = 4; i <= end; i += 2) {
+		if((*keyHistory)[last - i] == st->positionKey && (ply > i || ++repetitions >= 2)) {
+			return true;
 		}
 	}
 
-	return repetitions >= 2;
+	return false;
 }
 
-bool Position::checkDraw() const {
-	if(fiftyMoveCount > 99 || checkRepetition()) {
-		return true;
-	}
+// True when a reversible move leads to a position already reached after the root, so the
+// side to move can always claim at least a draw
+bool Position::hasGameCycle(int ply) const {
+	int last = keyHistory->size() - 1;
+	int end = std::min({ st->fiftyMoveCount, st->pliesFromNull, last, ply - 1 });
 
-	int pieceCount = popCount(getOccupied());
+	for(int i = 3; i <= end; i += 2) {
+		Key moveKey = st->positionKey ^ (*keyHistory)[last - i];
+		int j;
 
-	switch(pieceCount) {
-	case 2: {
-		return true;
-	}
-	case 3: {
-		if(getBitboard(KNIGHT) || getBitboard(BISHOP)) {
-			return true;
-		}
-	}
-	case 4: {
-		if(popCount(getBitboard(KNIGHT)) == 2) {
-			return true;
-		}
-		if(popCount(getBitboardColour(WHITE)) == popCount(getBitboardColour(BLACK))) {
-			return true;
-		}
-		else if(popCount(getBitboard(BISHOP))) {
-			return false;
+		if((j = cuckooH1(moveKey), cuckoo[j] == moveKey) || (j = cuckooH2(moveKey), cuckoo[j] == moveKey)) {
+			Move move = cuckooMove[j];
+
+			if(!(lookups::intervening_sqs(getFrom(move), getTo(move)) & getOccupied())) {
+				return true;
+			}
 		}
-		else return true;
-	}
 	}
 
 	return false;
 }
 
+bool Position::checkDraw(int ply) const {
+	if(st->fiftyMoveCount > 99 || checkRepetition(ply)) {
+		return true;
+	}
+
+	// Only a lone minor piece is left, so neither side can mate. Other drawish
+	// material is scaled down by the evaluation instead.
+	return !(getBitboard(PAWN) | getBitboard(ROOK) | getBitboard(QUEEN)) && popCount(getOccupied()) <= 3;
+}
+
 bool Position::checkNonPawnMaterial(Colour colour) const {
 	for(PieceType pieceType = KNIGHT; pieceType < KING; ++pieceType) {
 		if((bitboardsColour[colour] & bitboardsType[pieceType]) > uint64_t(0)) return true;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <iostream> // temporary for debugging
 #include <string>
@@ -7,6 +8,7 @@
 
 #include "bitboard.h"
 #include "defines.h"
+#include "nnue.h"
 
 class Position;
 class Thread;
@@ -22,22 +24,96 @@ namespace castling {
 	inline int castlingRightsMask[SQUARE_COUNT];
 }
 
-struct Undo {
-	int castleRights = 0;
+namespace Zobrist {
+	extern Key psq[PIECE_COUNT][SQUARE_COUNT];
+	extern Key enpassant[FILE_COUNT];
+	extern Key castling[ALL_CASTLING];
+	extern Key side;
+	extern Key exclusion;
+	extern Key noPawns;
+
+	void init();
+}
+
+// Material plus piece-square bonus of every piece on every square, from white's point
+// of view. The position keeps the sum for the pieces on the board up to date.
+namespace PSQT {
+	extern Score psq[PIECE_COUNT][SQUARE_COUNT];
+
+	void init();
+}
+
+// Check and pin information for the side to move, refreshed after every move so that
+// legality and gives-check tests are plain bitboard lookups
+struct CheckInfo {
+	Bitboard checkers = 0;
+	Bitboard blockersForKing[COLOUR_COUNT] = { 0 };
+	Bitboard pinners[COLOUR_COUNT] = { 0 };
+	Bitboard checkSquares[PIECE_TYPE_COUNT] = { 0 };
+};
+
+// The part of a state that makeMove copies over from the previous one
+struct CopiedState {
+	Key positionKey = 0;
+	Key pawnKey = 0;
+	Key materialKey = 0;
+	int castlingRights = NO_CASTLING;
 	int fiftyMoveCount = 0;
+	int pliesFromNull = 0;
+	Square enPassantSquare = NO_SQUARE;
+};
+
+// What cannot be recovered from the board when a move is taken back. makeMove links a
+// new state to the current one, and undoing the move just steps back along the chain.
+struct StateInfo : CopiedState {
+	// Set by makeMove
+	Piece capturedPiece = NO_PIECE;
+	StateInfo* previous = nullptr;
+	CheckInfo checkInfo;
+	NNUE::DirtyPiece dirtyPiece;
+};
+
+// Keys of every position played so far, oldest first. One of these is owned by each
+// thread and shared by all the positions it works on, so a Position stays cheap to copy.
+struct KeyHistory {
+	KeyHistory() = default;
+	KeyHistory(const KeyHistory& other) { *this = other; }
+
+	void clear() { count = 0; }
+	void push(Key key) { assert(count < MAX_GAME_PLY); keys[count++] = key; }
+	void pop() { assert(count > 0); --count; }
+	int size() const { return count; }
+	Key operator[](int i) const { return keys[i]; }
+	KeyHistory& operator=(const KeyHistory& other) {
+		count = other.count;
+		std::copy(other.keys, other.keys + count, keys);
+		return *this;
+	}
+
+private:
+	Key keys[MAX_GAME_PLY];
+	int count = 0;
+};
+
+// The board itself, small enough that copying a position is cheap. Everything a move
+// cannot undo lives in the state chain instead.
+struct BoardState {
+	Bitboard bitboardsType[PIECE_TYPE_COUNT];
+	Bitboard bitboardsColour[COLOUR_COUNT];
+	Piece board[SQUARE_COUNT] = { NO_PIECE };
+	Colour side = WHITE;
 	int ply = 0;
-	Square enpassantSquare = NO_SQUARE;
+	Score psqScore;
 
-	Key positionKey = 0;
-	Square captureSquare = NO_SQUARE;
-	Piece capturePiece = NO_PIECE;
+	Thread* thisThread = nullptr;
+	KeyHistory* keyHistory = nullptr;
 };
 
-class Position {
+class Position : private BoardState {
 public:
 	Position() = default; // To define the global object RootPos
-	// Position(const Position&) = delete;
-	Position(const Position& pos, Thread* thread) { *this = pos; thisThread = thread; }
+	Position(const Position&) = delete;
+	Position(const Position& pos, Thread* thread);
 	Position(const std::string& f, Thread* th) { init(f, th); }
 	Position& operator=(const Position&); // To assign RootPos from UCI
 
@@ -51,6 +127,11 @@ public:
 	Bitboard attackersTo(Square, Bitboard occupied, Colour side) const;
 	Bitboard checkersTo(Colour side) const;
 	Bitboard pinned(Colour side) const;
+	Bitboard getCheckers() const;
+	Bitboard getBlockersForKing(Colour side) const;
+	Bitboard getPinners(Colour side) const;
+	Bitboard getCheckSquares(PieceType type) const;
+	bool checkPseudoLegal(Move move) const;
 	bool checkLegality(Move move) const;
 	bool givesCheck(Move move) const;
 
@@ -68,8 +149,15 @@ public:
 	Bitboard getBitboardColour(Colour colour) const;
 	Bitboard getOccupied() const;
 	Key getPositionKey() const;
+	Key generatePositionKey() const;
+	Key getPawnKey() const;
+	Key generatePawnKey() const;
+	Key getMaterialKey() const;
+	Key generateMaterialKey() const;
 	Key getPrevPositionKey() const;
 	Key getExclusionKey() const;
+	Score getPsqScore() const;
+	StateInfo* getState() const;
 	Square getPosition(PieceType piece, Colour col) const;
 	bool checkPassedPawn(Square square) const;
 	bool checkCapture(Move move) const;
@@ -79,46 +167,36 @@ public:
 	int getPly() const;
 	int getFiftyMoveCount() const;
 
-	Value see(Move move) const;
-	Value seeSign(Move move) const;
+	bool see_ge(Move move, Value threshold = VALUE_ZERO) const;
 
-	bool checkRepetition() const;
-	bool checkDraw() const;
+	bool checkRepetition(int ply) const;
+	bool checkDraw(int ply) const;
+	bool hasGameCycle(int ply) const;
 
 	void setEnPassant(Square square);
 	Piece getCapture() const;
 	void setSide(Colour colour);
 	void switchSides();
 	Thread* getThread() const;
-	uint64_t nodes_searched() const;
-	void set_nodes_searched(uint64_t n);
-
-	void makeMove(Undo* newUndo, Move move);
-	void undoMove(Undo* undo, Move move);
-	bool testMove(Undo* undo, Move move);
-	void makeNullMove(Undo* undo);
-	void undoNullMove(Undo* undo);
+
+	void makeMove(StateInfo* newState, Move move);
+	void undoMove(Move move);
+	void makeNullMove(StateInfo* newState);
+	void undoNullMove();
 	bool validateMove(Move move) const;
 
 private:
 	void clear();
-	Piece board[64] = { NO_PIECE };
-	Bitboard bitboardsType[PIECE_TYPE_COUNT];
-	Bitboard bitboardsColour[COLOUR_COUNT];
-	Colour side = WHITE;
-	Thread* thisThread;
 
-	Square enPassantSquare = NO_SQUARE;
-	Piece capture = NO_PIECE;
-	int fiftyMoveCount = 0;
-	int ply = 0;
-	int castlingRights = NO_CASTLING;
-	uint64_t nodes = 0;
+	StateInfo* st = &rootState;
 
-	Key positionKey;
-	Key generatePositionKey();
-	Key prevPositionKey[512];
+	// A copied position starts a chain of its own here, so it does not point into the
+	// states of the position it was copied from
+	StateInfo rootState;
 
+	Bitboard sliderBlockers(Bitboard sliders, Square square, Bitboard& pinners) const;
+	void setCheckInfo();
+	void setCastlingRights(int rights);
 	void resetFiftyMoveCount();
 	void incrementFiftyMoveCount();
 	void decrementFiftyMoveCount();
@@ -141,7 +219,7 @@ inline MoveType Position::getMoveType(Move move) const {
 }
 
 inline Square Position::getEnPassantSquare() const {
-	return enPassantSquare;
+	return st->enPassantSquare;
 }
 
 inline PieceType Position::getPieceType(Piece piece) const {
@@ -170,6 +248,22 @@ inline Bitboard Position::getBitboardColour(Colour colour) const {
 	return bitboardsColour[colour];
 }
 
+inline Bitboard Position::getCheckers() const {
+	return st->checkInfo.checkers;
+}
+inline Bitboard Position::getBlockersForKing(Colour side) const {
+	return st->checkInfo.blockersForKing[side];
+}
+inline Bitboard Position::getPinners(Colour side) const {
+	return st->checkInfo.pinners[side];
+}
+inline Bitboard Position::getCheckSquares(PieceType type) const {
+	return st->checkInfo.checkSquares[type];
+}
+inline Bitboard Position::pinned(Colour side) const {
+	return st->checkInfo.blockersForKing[side] & bitboardsColour[side];
+}
+
 inline Bitboard Position::getOccupied() const {
 	return bitboardsColour[WHITE] ^ bitboardsColour[BLACK];
 }
@@ -180,37 +274,63 @@ inline Square Position::getPosition(PieceType piece, Colour col) const {
 
 inline void Position::switchSides() {
 	side = ~side;
+	st->positionKey ^= Zobrist::side;
 }
 
 inline void Position::resetFiftyMoveCount() {
-	fiftyMoveCount = 0;
+	st->fiftyMoveCount = 0;
 }
 
 inline void Position::incrementFiftyMoveCount() {
-	++fiftyMoveCount;
+	++st->fiftyMoveCount;
 }
 
 inline void Position::decrementFiftyMoveCount() {
-	--fiftyMoveCount;
+	--st->fiftyMoveCount;
 }
 
 inline void Position::setEnPassant(Square square) {
-	enPassantSquare = square;
+	if(st->enPassantSquare != NO_SQUARE) {
+		st->positionKey ^= Zobrist::enpassant[getFile(st->enPassantSquare)];
+	}
+	if(square != NO_SQUARE) {
+		st->positionKey ^= Zobrist::enpassant[getFile(square)];
+	}
+	st->enPassantSquare = square;
+}
+
+inline void Position::setCastlingRights(int rights) {
+	st->positionKey ^= Zobrist::castling[st->castlingRights] ^ Zobrist::castling[rights];
+	st->castlingRights = rights;
 }
 
 inline void Position::setSide(Colour colour) {
-	side = colour;
+	if(colour != side) {
+		switchSides();
+	}
 }
 
 inline Key Position::getPositionKey() const {
-	return positionKey;
+	return st->positionKey;
+}
+inline Key Position::getPawnKey() const {
+	return st->pawnKey;
+}
+inline Key Position::getMaterialKey() const {
+	return st->materialKey;
+}
+inline Score Position::getPsqScore() const {
+	return psqScore;
+}
+inline StateInfo* Position::getState() const {
+	return st;
 }
 inline Key Position::getPrevPositionKey() const {
-	return ply ? prevPositionKey[ply - 1] : 0;
+	return keyHistory->size() > 1 ? (*keyHistory)[keyHistory->size() - 2] : 0;
 }
 
 inline bool Position::checkCapture(Move move) const {
-	return (getPieceOnSquare(getTo(move)) == NO_SQUARE && getMoveType(move) != CASTLING) || getMoveType(move) == ENPASSANT;
+	return (getPieceOnSquare(getTo(move)) != NO_PIECE && getMoveType(move) != CASTLING) || getMoveType(move) == ENPASSANT;
 }
 
 inline bool Position::checkAdvancedPawnPush(Move move) const {
@@ -218,28 +338,22 @@ inline bool Position::checkAdvancedPawnPush(Move move) const {
 }
 
 inline int Position::getCastlingRights() const {
-	return castlingRights;
+	return st->castlingRights;
 }
 inline int Position::getPly() const {
 	return ply;
 }
 inline int Position::getFiftyMoveCount() const {
-	return fiftyMoveCount;
+	return st->fiftyMoveCount;
 }
 
 inline Piece Position::getCapture() const {
-	return capture;
+	return st->capturedPiece;
 }
 
 inline Thread* Position::getThread() const {
 	return thisThread;
 }
-inline uint64_t Position::nodes_searched() const {
-	return nodes;
-}
-inline void Position::set_nodes_searched(uint64_t n) {
-	nodes = n;
-}
 
 
 inline void Position::placePiece(Square square, Piece piece) {
@@ -250,6 +364,11 @@ inline void Position::placePiece(Square square, Piece piece) {
 	bitboardsType[getPieceType(piece)] |= bit;
 	bitboardsColour[getPieceColour(piece)] |= bit;
 	board[square] = piece;
+	psqScore += PSQT::psq[piece][square];
+	st->positionKey ^= Zobrist::psq[piece][square];
+	if(getPieceType(piece) == PAWN) {
+		st->pawnKey ^= Zobrist::psq[piece][square];
+	}
 }
 
 inline void Position::removePiece(Square square, Piece piece) {
@@ -260,6 +379,11 @@ inline void Position::removePiece(Square square, Piece piece) {
 	bitboardsType[getPieceType(piece)] ^= bit;
 	bitboardsColour[getPieceColour(piece)] ^= bit;
 	board[square] = NO_PIECE;
+	psqScore -= PSQT::psq[piece][square];
+	st->positionKey ^= Zobrist::psq[piece][square];
+	if(getPieceType(piece) == PAWN) {
+		st->pawnKey ^= Zobrist::psq[piece][square];
+	}
 }
 
 inline void Position::movePiece(Square from, Square to) {
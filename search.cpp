@@ -11,6 +11,7 @@
 #include "utils.h"
 #include "movegen.h"
 #include "movepick.h"
+#include "perft.h"
 #include "search.h"
 #include "time.h"
 #include "thread.h"
@@ -20,7 +21,7 @@
 namespace Search {
     SignalsType Signals;
     LimitsType Limits;
-    UndoStackPtr SetupUndo;
+    StateListPtr SetupStates;
 }
 
 namespace Tablebases {
@@ -74,12 +75,12 @@ namespace {
             {
                 std::copy(newPv.begin(), newPv.begin() + 3, pv);
 
-                Undo undo[2];
-                position.makeMove(undo, newPv[0]);
-                position.makeMove(undo + 1, newPv[1]);
+                StateInfo states[2];
+                position.makeMove(states, newPv[0]);
+                position.makeMove(states + 1, newPv[1]);
                 expectedPosKey = position.getPositionKey();
-                position.undoMove(undo + 1, newPv[1]);
-                position.undoMove(undo, newPv[0]);
+                position.undoMove(newPv[1]);
+                position.undoMove(newPv[0]);
             }
         }
 
@@ -135,6 +136,7 @@ void Search::init() {
 void Search::clear() {
 
     TT.clear();
+    EvalHash.clear();
     CounterMovesHistory.clear();
 
     for(Thread* th : Threads)
@@ -144,38 +146,31 @@ void Search::clear() {
     }
 }
 
-template<bool Root>
-uint64_t Search::perft(Position position, Depth depth) {
-    ExtMove moveList[MAX_MOVES];
-    Undo undo[1];
-    uint64_t leaves = uint64_t(0);
+void MainThread::search() {
+    if(Limits.perft) {
+        Perft::start(rootMoves.size());
 
-    int size = generateLegalMoves(position, moveList);
-    if(depth == 1) {
-        return size;
-    }
+        for(Thread* thread : Threads) {
+            if(thread != this) {
+                thread->keyHistory = keyHistory;
+                thread->rootPos = Position(rootPos, thread);
+                thread->rootMoves = rootMoves;
+                thread->start_searching();
+            }
+        }
 
-    for(size -= 1; size >= 0; size--) {
-        Position child = position;
-        child.makeMove(undo, moveList[size]);
+        Thread::search();
 
-        if(child.checkersTo(~child.getSide())) {
-            continue;
+        for(Thread* thread : Threads) {
+            if(thread != this) {
+                thread->wait_for_search_finished();
+            }
         }
-        uint64_t count = perft(child, depth - 1, false);
-        leaves += count;
 
-        if(Root == true) {
-            std::cout << getMoveString(moveList[size]) << ": " << count << std::endl;
-        }
+        Perft::report(*this);
+        return;
     }
 
-    return leaves;
-}
-
-template uint64_t Search::perft<true>(Position, Depth);
-
-void MainThread::search() {
     Colour us = rootPos.getSide();
     Time.init(Limits, us, rootPos.getPly());
 
@@ -186,7 +181,7 @@ void MainThread::search() {
     if(rootMoves.empty()) {
         rootMoves.push_back(RootMove(NO_MOVE));
         sync_cout << "info depth 0 score "
-            << UCI::value(rootPos.checkersTo(us) ? -VALUE_MATE : VALUE_DRAW)
+            << UCI::value(rootPos.getCheckers() ? -VALUE_MATE : VALUE_DRAW)
             << sync_endl;
     }
     else {
@@ -194,6 +189,7 @@ void MainThread::search() {
             thread->maxPly = 0;
             thread->rootDepth = DEPTH_ZERO;
             if(thread != this) {
+                thread->keyHistory = keyHistory;
                 thread->rootPos = Position(rootPos, thread);
                 thread->rootMoves = rootMoves;
                 thread->start_searching();
@@ -234,6 +230,18 @@ void MainThread::search() {
         sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
     }
 
+    if(Options["Eval Hash Stats"]) {
+        uint64_t probes = 0, hits = 0;
+
+        for(Thread* thread : Threads) {
+            probes += thread->evalProbes;
+            hits += thread->evalHits;
+        }
+
+        sync_cout << "info string eval hash hits " << hits << " of " << probes << " probes ("
+            << (probes ? hits * 100 / probes : 0) << "%)" << sync_endl;
+    }
+
     sync_cout << "bestmove " << UCI::move(bestThread->rootMoves[0].pv[0]);
 
     if(bestThread->rootMoves[0].pv.size() > 1 || bestThread->rootMoves[0].extract_ponder_from_tt(rootPos)) {
@@ -244,12 +252,16 @@ void MainThread::search() {
 }
 
 void Thread::search() {
+    if(Limits.perft) {
+        return Perft::search(*this);
+    }
+
     Stack stack[MAX_PLY + 4], * ss = stack + 2;
     Value bestValue, alpha, beta, delta;
     Move easyMove = NO_MOVE;
     MainThread* mainThread = (this == Threads.main() ? Threads.main() : nullptr);
 
-    std::memset(ss - 2, 0, 5 * sizeof(Stack));
+    std::fill(ss - 2, ss + 3, Stack());
 
     bestValue = delta = alpha = -VALUE_INFINITE;
     beta = VALUE_INFINITE;
@@ -425,7 +437,6 @@ namespace {
         assert(DEPTH_ZERO < depth&& depth < DEPTH_MAX);
 
         Move pv[MAX_PLY + 1], quietsSearched[64];
-        Undo undo[1];
         TTEntry* tte;
         Key posKey;
         Move ttMove, move, excludedMove, bestMove;
@@ -438,7 +449,7 @@ namespace {
         int moveCount, quietCount;
 
         Thread* thisThread = position.getThread();
-        inCheck = bool(position.checkersTo(position.getSide()));
+        inCheck = bool(position.getCheckers());
         moveCount = quietCount = ss->moveCount = 0;
         bestValue = -VALUE_INFINITE;
         ss->ply = (ss - 1)->ply + 1;
@@ -460,10 +471,20 @@ namespace {
         }
 
         if(!RootNode) {
-            if(Signals.stop.load(std::memory_order_relaxed) || position.checkDraw() || ss->ply >= MAX_PLY) {
+            if(Signals.stop.load(std::memory_order_relaxed) || position.checkDraw(ss->ply - 1) || ss->ply >= MAX_PLY) {
                 return ss->ply >= MAX_PLY && !inCheck ? (Value)evaluate(position)
                                                       : DrawValue[position.getSide()];
             }
+
+            // We can repeat a position from earlier in the tree, so a draw is the least we get
+            if(alpha < DrawValue[position.getSide()] && position.hasGameCycle(ss->ply - 1)) {
+                alpha = DrawValue[position.getSide()];
+
+                if(alpha >= beta) {
+                    return alpha;
+                }
+            }
+
             alpha = std::max(-VALUE_MATE + (ss->ply), alpha);
             beta = std::min(VALUE_MATE - (ss->ply + 1), beta);
 
@@ -559,12 +580,12 @@ namespace {
 
             Depth R = ((823 + 67 * depth) / 256 + std::min((eval - beta) / valuePawnMg, 3)) * ONE_PLY;
 
-            position.makeNullMove(undo);
+            position.makeNullMove(&ss->state);
             (ss + 1)->skipEarlyPruning = true;
             nullValue = depth - R < ONE_PLY ? -qsearch<NonPV, false>(position, ss + 1, -beta, -beta + 1, DEPTH_ZERO)
                 : -search<NonPV>(position, ss + 1, -beta, -beta + 1, depth - R, !cutNode);
             (ss + 1)->skipEarlyPruning = false;
-            position.undoNullMove(undo);
+            position.undoNullMove();
 
             if(nullValue >= beta) {
                 if(nullValue >= VALUE_MATE_IN_MAX_PLY) {
@@ -596,22 +617,16 @@ namespace {
             assert((ss - 1)->currentMove != NO_MOVE);
             assert((ss - 1)->currentMove != NULL_MOVE);
 
-            MovePicker mp(position, ttMove, thisThread->history, Value(pieceValue[position.getCapture()].value()));
+            MovePicker mp(position, ttMove, thisThread->history, Value(pieceValue[getPieceType(position.getCapture())].value()));
 
             while((move = mp.next_move()) != NO_MOVE) {
-                if(position.checkLegality(move)) {
-                    ss->currentMove = move;
-                    Position child = position;
-                    child.makeMove(undo, move);
+                ss->currentMove = move;
+                position.makeMove(&ss->state, move);
+                value = -search<NonPV>(position, ss + 1, -rbeta, -rbeta + 1, rdepth, !cutNode);
+                position.undoMove(move);
 
-                    if(child.checkersTo(~child.getSide())) {
-                        continue;
-                    }
-                    value = -search<NonPV>(child, ss + 1, -rbeta, -rbeta + 1, rdepth, !cutNode);
-
-                    if(value >= rbeta) {
-                        return value;
-                    }
+                if(value >= rbeta) {
+                    return value;
                 }
             }
         }
@@ -650,14 +665,6 @@ namespace {
             && tte->depth() >= depth - 3 * ONE_PLY;
 
         while((move = mp.next_move()) != NO_MOVE) {
-            if(!position.checkLegality(move)) continue;
-            
-            Position child = position;
-            child.makeMove(undo, move);
-
-            if(child.checkersTo(~child.getSide())) {
-                continue;
-            }
             if(move == excludedMove) {
                 continue;
             }
@@ -683,14 +690,13 @@ namespace {
             isTactical = checkTactical(&position, move);
 
             givesCheck = position.givesCheck(move);
-            if(givesCheck && position.seeSign(move) >= VALUE_ZERO) {
+            if(givesCheck && position.see_ge(move)) {
                 extension = ONE_PLY;
             }
 
             if(singularExtensionNode
                 && move == ttMove
-                && !extension
-            && position.checkLegality(move)) {
+            && !extension) {
                 Value rBeta = ttValue - 2 * depth / ONE_PLY;
                 ss->excludedMove = move;
                 ss->skipEarlyPruning = true;
@@ -733,41 +739,37 @@ namespace {
                     }
                 }
 
-                if(predictedDepth < 4 * ONE_PLY && position.seeSign(move) < VALUE_ZERO) {
+                if(predictedDepth < 4 * ONE_PLY && !position.see_ge(move)) {
                     continue;
                 }
             }
 
-            if(!RootNode && !position.checkLegality(move)) {
-                ss->moveCount = --moveCount;
-                continue;
-            }
-
             ss->currentMove = move;
+            position.makeMove(&ss->state, move);
 
             if(depth >= 3 * ONE_PLY && moveCount > 1 && !isTactical) {
                 Depth r = reduction<PvNode>(improving, depth, moveCount);
 
                 if((!PvNode && cutNode)
-                    || (thisThread->history[child.getPieceOnSquare(getTo(move))][getTo(move)] < VALUE_ZERO
-                && cmh[child.getPieceOnSquare(getTo(move))][getTo(move)] <= VALUE_ZERO)) {
+                    || (thisThread->history[position.getPieceOnSquare(getTo(move))][getTo(move)] < VALUE_ZERO
+                && cmh[position.getPieceOnSquare(getTo(move))][getTo(move)] <= VALUE_ZERO)) {
                     r += ONE_PLY;
                 }
 
-                if(thisThread->history[child.getPieceOnSquare(getTo(move))][getTo(move)] > VALUE_ZERO
-                && cmh[child.getPieceOnSquare(getTo(move))][getTo(move)] > VALUE_ZERO) {
+                if(thisThread->history[position.getPieceOnSquare(getTo(move))][getTo(move)] > VALUE_ZERO
+                && cmh[position.getPieceOnSquare(getTo(move))][getTo(move)] > VALUE_ZERO) {
                     r = std::max(DEPTH_ZERO, r - ONE_PLY);
                 }
 
                 if(r && getMoveType(move) == NORMAL
-                    && getPieceType(child.getPieceOnSquare(getTo(move))) != PAWN
-                && child.see(fromAndTo(getTo(move), getFrom(move))) < VALUE_ZERO) {
+                    && getPieceType(position.getPieceOnSquare(getTo(move))) != PAWN
+                && !position.see_ge(fromAndTo(getTo(move), getFrom(move)))) {
                     r = std::max(DEPTH_ZERO, r - ONE_PLY);
                 }
 
                 Depth d = std::max(newDepth - r, ONE_PLY);
 
-                value = -search<NonPV>(child, ss + 1, -(alpha + 1), -alpha, d, true);
+                value = -search<NonPV>(position, ss + 1, -(alpha + 1), -alpha, d, true);
 
                 doFullDepthSearch = (value > alpha && r != DEPTH_ZERO);
             }
@@ -777,9 +779,9 @@ namespace {
 
             if(doFullDepthSearch) {
                 value = newDepth < ONE_PLY ?
-                givesCheck ? -qsearch<NonPV, true>(child, ss + 1, -(alpha + 1), -alpha, DEPTH_ZERO)
-                : -qsearch<NonPV, false>(child, ss + 1, -(alpha + 1), -alpha, DEPTH_ZERO)
-                : -search<NonPV>(child, ss + 1, -(alpha + 1), -alpha, newDepth, !cutNode);
+                givesCheck ? -qsearch<NonPV, true>(position, ss + 1, -(alpha + 1), -alpha, DEPTH_ZERO)
+                : -qsearch<NonPV, false>(position, ss + 1, -(alpha + 1), -alpha, DEPTH_ZERO)
+                : -search<NonPV>(position, ss + 1, -(alpha + 1), -alpha, newDepth, !cutNode);
             }
 
             if(PvNode && (moveCount == 1 || (value > alpha && (RootNode || value < beta)))) {
@@ -787,11 +789,14 @@ namespace {
                 (ss + 1)->pv[0] = NO_MOVE;
 
                 value = newDepth < ONE_PLY ?
-                    givesCheck ? -qsearch<PV, true>(child, ss + 1, -beta, -alpha, DEPTH_ZERO)
-                    : -qsearch<PV, false>(child, ss + 1, -beta, -alpha, DEPTH_ZERO)
-                    : -search<PV>(child, ss + 1, -beta, -alpha, newDepth, false);
+                    givesCheck ? -qsearch<PV, true>(position, ss + 1, -beta, -alpha, DEPTH_ZERO)
+                    : -qsearch<PV, false>(position, ss + 1, -beta, -alpha, DEPTH_ZERO)
+                    : -search<PV>(position, ss + 1, -beta, -alpha, newDepth, false);
             }
 
+            Key childKey = position.getPositionKey();
+            position.undoMove(move);
+
             assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
             if(Signals.stop.load(std::memory_order_relaxed)) {
@@ -826,8 +831,8 @@ namespace {
                 if(value > alpha) {
                     if(PvNode
                         && thisThread == Threads.main()
-                        && EasyMove.get(child.getPositionKey())
-                    && (move != EasyMove.get(child.getPositionKey()) || moveCount > 1)) {
+                        && EasyMove.get(childKey)
+                    && (move != EasyMove.get(childKey) || moveCount > 1)) {
                         EasyMove.clear();
                     }
 
@@ -864,8 +869,8 @@ namespace {
             && !bestMove
             && !inCheck
             && !position.getCapture()
-            && position.checkLegality((ss - 1)->currentMove)
-        && position.checkLegality((ss - 2)->currentMove)) {
+            && isValidMove((ss - 1)->currentMove)
+        && isValidMove((ss - 2)->currentMove)) {
             Value bonus = Value((depth / ONE_PLY) * (depth / ONE_PLY) + depth / ONE_PLY - 1);
             Square prevPrevSq = getTo((ss - 2)->currentMove);
             CounterMovesStats& prevCmh = CounterMovesHistory[position.getPieceOnSquare(prevPrevSq)][prevPrevSq];
@@ -885,11 +890,11 @@ namespace {
     template <NodeType NT, bool InCheck>
     Value qsearch(Position& position, Stack* ss, Value alpha, Value beta, Depth depth) {
         const bool PvNode = NT == PV;
-        /*if(InCheck != bool(position.checkersTo(position.getSide()))) {
+        /*if(InCheck != bool(position.getCheckers())) {
             std::cout << "InCheck is:" << InCheck << std::endl;
-            std::cout << "check is:" << bool(position.checkersTo(position.getSide())) << std::endl;
+            std::cout << "check is:" << bool(position.getCheckers()) << std::endl;
             std::cout << "checkersTo\n";
-            print_bb(position.checkersTo(position.getSide()));
+            print_bb(position.getCheckers());
             std::cout << "colour BB White\n";
             print_bb(position.getBitboardColour(position.getSide()));
             std::cout << "colour BB Black\n";
@@ -897,20 +902,19 @@ namespace {
             position.display();
         }*/
         assert(NT == PV || NT == NonPV);
-        assert(InCheck == bool(position.checkersTo(position.getSide())));
+        assert(InCheck == bool(position.getCheckers()));
         assert(alpha >= -VALUE_INFINITE && alpha < beta&& beta <= VALUE_INFINITE);
         assert(PvNode || (alpha == beta - 1));
         assert(depth <= DEPTH_ZERO);
 
         Move pv[MAX_PLY + 1];
-        Undo undo[1];
         TTEntry* tte;
         Key posKey;
         Move ttMove, move, bestMove;
         Value bestValue = VALUE_ZERO;
         Value value = VALUE_ZERO;
-        Value ttValue, futilityValue, futilityBase, oldAlpha;
-        bool ttHit, givesCheck, evasionPrunable;
+        Value ttValue, ttEval, futilityValue, futilityBase, oldAlpha;
+        bool ttHit, givesCheck, evasionPrunable, lazyEval = false;
         Depth ttDepth;
 
         if(PvNode) {
@@ -922,7 +926,7 @@ namespace {
         ss->currentMove = bestMove = NO_MOVE;
         ss->ply = (ss - 1)->ply + 1;
 
-        if(position.checkDraw() || ss->ply >= MAX_PLY) {
+        if(position.checkDraw(ss->ply - 1) || ss->ply >= MAX_PLY) {
             return ss->ply >= MAX_PLY && !InCheck ? Value(evaluate(position))
             : DrawValue[position.getSide()];
         }
@@ -946,13 +950,13 @@ namespace {
         }
 
         if(InCheck) {
-            ss->staticEval = VALUE_NONE;
+            ss->staticEval = ttEval = VALUE_NONE;
             bestValue = futilityBase = -VALUE_INFINITE;
         }
         else {
             if(ttHit) {
                 if((ss->staticEval = bestValue = tte->eval()) == VALUE_NONE) {
-                    ss->staticEval = bestValue = Value(evaluate(position));
+                    ss->staticEval = bestValue = Value(evaluate(position, alpha, beta, lazyEval));
                 }
 
                 if(ttValue != VALUE_NONE) {
@@ -963,14 +967,17 @@ namespace {
             }
             else {
                 ss->staticEval = bestValue =
-                (ss - 1)->currentMove != NULL_MOVE ? Value(evaluate(position))
+                (ss - 1)->currentMove != NULL_MOVE ? Value(evaluate(position, alpha, beta, lazyEval))
                 : -(ss - 1)->staticEval + 2 * Tempo;
             }
 
+            // A lazy evaluation is kept out of the table, where search would take it as exact
+            ttEval = lazyEval ? VALUE_NONE : ss->staticEval;
+
             if(bestValue >= beta) {
                 if(!ttHit) {
                     tte->save(position.getPositionKey(), value_to_tt(bestValue, ss->ply), BOUND_LOWER,
-                        DEPTH_NONE, NO_MOVE, ss->staticEval, TT.generation());
+                        DEPTH_NONE, NO_MOVE, ttEval, TT.generation());
                 }
 
                 return bestValue;
@@ -986,14 +993,6 @@ namespace {
         MovePicker mp(position, ttMove, depth, position.getThread()->history, getTo((ss - 1)->currentMove));
 
         while((move = mp.next_move()) != NO_MOVE) {
-            Position child = position;
-            if(!position.checkLegality(move)) continue;
-
-            child.makeMove(undo, move);
-            if(child.checkersTo(~child.getSide())) {
-                continue;
-            }
-
             givesCheck = position.givesCheck(move);
 
             if(!InCheck
@@ -1002,31 +1001,33 @@ namespace {
             && !position.checkAdvancedPawnPush(move)) {
                 assert(getMoveType(move) != ENPASSANT);
 
-                futilityValue = futilityBase + pieceValue[position.getPieceOnSquare(getTo(move))].value();
+                futilityValue = futilityBase + pieceValue[getPieceType(position.getPieceOnSquare(getTo(move)))].value();
 
                 if(futilityValue <= alpha) {
                     bestValue = std::max(bestValue, futilityValue);
                     continue;
                 }
 
-                if(futilityBase <= alpha && position.see(move) <= VALUE_ZERO) {
+                if(futilityBase <= alpha && !position.see_ge(move, VALUE_ZERO + 1)) {
                     bestValue = std::max(bestValue, futilityBase);
                     continue;
                 }
             }
 
-            evasionPrunable = InCheck && bestValue > VALUE_MATED_IN_MAX_PLY && !child.getCapture();
+            evasionPrunable = InCheck && bestValue > VALUE_MATED_IN_MAX_PLY && !position.checkCapture(move);
 
             if((!InCheck || evasionPrunable)
                 && getMoveType(move) != PROMOTION
-            && position.seeSign(move) < VALUE_ZERO) {
+            && !position.see_ge(move)) {
                 continue;
             }
 
             ss->currentMove = move;
+            position.makeMove(&ss->state, move);
 
-            value = givesCheck ? -qsearch<NT, true>(child, ss + 1, -beta, -alpha, depth - ONE_PLY)
-                : -qsearch<NT, false>(child, ss + 1, -beta, -alpha, depth - ONE_PLY);
+            value = givesCheck ? -qsearch<NT, true>(position, ss + 1, -beta, -alpha, depth - ONE_PLY)
+                : -qsearch<NT, false>(position, ss + 1, -beta, -alpha, depth - ONE_PLY);
+            position.undoMove(move);
 
             assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
@@ -1044,7 +1045,7 @@ namespace {
                     }
                     else {
                         tte->save(posKey, value_to_tt(value, ss->ply), BOUND_LOWER,
-                            ttDepth, move, ss->staticEval, TT.generation());
+                            ttDepth, move, ttEval, TT.generation());
 
                         return value;
                     }
@@ -1058,7 +1059,7 @@ namespace {
 
         tte->save(posKey, value_to_tt(bestValue, ss->ply),
             PvNode && bestValue > oldAlpha ? BOUND_EXACT : BOUND_UPPER,
-            ttDepth, bestMove, ss->staticEval, TT.generation());
+            ttDepth, bestMove, ttEval, TT.generation());
 
         assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
 
@@ -1098,7 +1099,7 @@ namespace {
 
         thisThread->history.update(position.getPieceOnSquare(getFrom(move)), getTo(move), bonus);
 
-        if(position.checkLegality((ss - 1)->currentMove)) {
+        if(isValidMove((ss - 1)->currentMove)) {
             thisThread->counterMoves.update(position.getPieceOnSquare(prevSq), prevSq, move);
             cmh.update(position.getPieceOnSquare(getFrom(move)), getTo(move), bonus);
         }
@@ -1106,13 +1107,13 @@ namespace {
         for(int i = 0; i < quietsCount; ++i) {
             thisThread->history.update(position.getPieceOnSquare(getFrom(quiets[i])), getTo(quiets[i]), -bonus);
 
-            if(position.checkLegality((ss - 1)->currentMove))
+            if(isValidMove((ss - 1)->currentMove))
                 cmh.update(position.getPieceOnSquare(getFrom(quiets[i])), getTo(quiets[i]), -bonus);
         }
 
         if((ss - 1)->moveCount == 1
             && !position.getCapture()
-        && position.checkLegality((ss - 2)->currentMove)) {
+        && isValidMove((ss - 2)->currentMove)) {
             Square prevPrevSq = getTo((ss - 2)->currentMove);
             CounterMovesStats& prevCmh = CounterMovesHistory[position.getPieceOnSquare(prevPrevSq)][prevPrevSq];
             prevCmh.update(position.getPieceOnSquare(prevSq), prevSq, -bonus - 2 * (depth + 1) / ONE_PLY);
@@ -1192,7 +1193,7 @@ string UCI::pv(const Position& position, Depth depth, Value alpha, Value beta) {
 }
 
 void RootMove::insert_pv_in_tt(Position& position) {
-    Undo undo[MAX_PLY], *ud = undo;
+    StateInfo states[MAX_PLY], *st = states;
     bool ttHit;
 
     for(Move move : pv) {
@@ -1203,23 +1204,23 @@ void RootMove::insert_pv_in_tt(Position& position) {
             tte->save(position.getPositionKey(), VALUE_NONE, BOUND_NONE, DEPTH_NONE,
                 move, VALUE_NONE, TT.generation());
 
-        position.makeMove(ud++, move);
+        position.makeMove(st++, move);
     }
 
     for(size_t i = pv.size(); i > 0; ) {
-        position.undoMove(--ud, pv[--i]);
+        position.undoMove(pv[--i]);
     }
 }
 
 bool RootMove::extract_ponder_from_tt(Position& position) {
-    Undo undo[1];
+    StateInfo state;
     bool ttHit;
 
     assert(pv.size() == 1);
 
-    position.makeMove(undo, pv[0]);
+    position.makeMove(&state, pv[0]);
     TTEntry* tte = TT.probe(position.getPositionKey(), ttHit);
-    position.undoMove(undo, pv[0]);
+    position.undoMove(pv[0]);
 
     if(ttHit) {
         Move move = tte->move();
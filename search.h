@@ -1,7 +1,7 @@
 #pragma once
 #include <atomic>
+#include <deque>
 #include <memory>
-#include <stack>
 #include <vector>
 
 #include "utils.h"
@@ -19,6 +19,7 @@ namespace Search {
         Value staticEval;
         bool skipEarlyPruning;
         int moveCount;
+        StateInfo state;
     };
 
     struct RootMove {
@@ -39,15 +40,15 @@ namespace Search {
     struct LimitsType {
         LimitsType() {
             nodes = time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movestogo =
-                depth = movetime = mate = infinite = ponder = 0;
+                depth = movetime = mate = infinite = ponder = perft = 0;
         }
 
         bool use_time_management() const {
-            return !(mate | movetime | depth | nodes | infinite);
+            return !(mate | movetime | depth | nodes | perft | infinite);
         }
 
         std::vector<Move> searchmoves;
-        int time[COLOUR_COUNT], inc[COLOUR_COUNT], npmsec, movestogo, depth, movetime, mate, infinite, ponder;
+        int time[COLOUR_COUNT], inc[COLOUR_COUNT], npmsec, movestogo, depth, movetime, mate, infinite, ponder, perft;
         int64_t nodes;
         TimePoint startTime;
     };
@@ -56,13 +57,12 @@ namespace Search {
         std::atomic_bool stop, stopOnPonderhit;
     };
 
-    typedef std::unique_ptr<std::stack<Undo>> UndoStackPtr;
+    typedef std::unique_ptr<std::deque<StateInfo>> StateListPtr;
 
     extern SignalsType Signals;
     extern LimitsType Limits;
-    extern UndoStackPtr SetupUndo;
+    extern StateListPtr SetupStates;
 
     void init();
     void clear();
-    template<bool Root = true> uint64_t perft(Position position, Depth depth);
 }
\ No newline at end of file
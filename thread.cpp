@@ -13,6 +13,7 @@ ThreadPool Threads; // Global object
 Thread::Thread() {
     resetCalls = exit = false;
     maxPly = callsCount = 0;
+    evalProbes = evalHits = 0;
     history.clear();
     counterMoves.clear();
     idx = Threads.size();
@@ -82,8 +83,10 @@ void ThreadPool::exit() {
 }
 
 void ThreadPool::read_uci_options() {
-    size_t requested = Options["Threads"];
+    set(Options["Threads"]);
+}
 
+void ThreadPool::set(size_t requested) {
     assert(requested > 0);
 
     while(size() < requested)
@@ -96,12 +99,12 @@ void ThreadPool::read_uci_options() {
 int64_t ThreadPool::nodes_searched() {
     int64_t nodes = 0;
     for(Thread* th : *this)
-        nodes += th->rootPos.nodes_searched();
+        nodes += th->nodes.load(std::memory_order_relaxed);
     return nodes;
 }
 
 void ThreadPool::start_thinking(const Position& position, const LimitsType& limits,
-    UndoStackPtr& states) {
+    StateListPtr& states) {
 
     main()->wait_for_search_finished();
 
@@ -109,9 +112,12 @@ void ThreadPool::start_thinking(const Position& position, const LimitsType& limi
 
     main()->rootMoves.clear();
     main()->rootPos = position;
+
+    for(Thread* th : *this)
+        th->nodes = th->evalProbes = th->evalHits = 0;
     Limits = limits;
     if(states.get()) {
-        SetupUndo = std::move(states);
+        SetupStates = std::move(states);
         assert(!states.get());
     }
 
@@ -17,7 +17,9 @@
 #include <thread>
 #include <vector>
 
+#include "material.h"
 #include "movepick.h"
+#include "pawns.h"
 #include "position.h"
 #include "search.h"
 
@@ -40,10 +42,17 @@ public:
 	int maxPly, callsCount;
 
 	Position rootPos;
+	KeyHistory keyHistory;
+	std::atomic<uint64_t> nodes;
+	uint64_t evalProbes, evalHits; // Read only once the search is over
 	Search::RootMoveVector rootMoves;
 	Depth rootDepth;
 	HistoryStats history;
 	MovesStats counterMoves;
+	Material::Table materialTable;
+	Pawns::Table pawnsTable;
+	NNUE::AccumulatorStack accumulators;
+	NNUE::RefreshCache refreshCache;
 	Depth completedDepth;
 	std::atomic_bool resetCalls;
 };
@@ -60,8 +69,9 @@ struct ThreadPool : public std::vector<Thread*> {
 	void exit();
 
 	MainThread* main() { return static_cast<MainThread*>(at(0)); }
-	void start_thinking(const Position&, const Search::LimitsType&, Search::UndoStackPtr&);
+	void start_thinking(const Position&, const Search::LimitsType&, Search::StateListPtr&);
 	void read_uci_options();
+	void set(size_t requested);
 	int64_t nodes_searched();
 };
 
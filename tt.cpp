@@ -5,6 +5,7 @@
 #include "tt.h"
 
 TranspositionTable TT; // Our global transposition table
+EvalCache EvalHash;
 
 void TranspositionTable::resize(size_t mbSize) {
     size_t newClusterCount = size_t(1) << rbitscan((mbSize * 1024 * 1024) / sizeof(Cluster));
@@ -69,3 +70,21 @@ int TranspositionTable::hashfull() const {
     }
     return count;
 }
+
+
+void EvalCache::resize(size_t mbSize) {
+    size_t newEntryCount = size_t(1) << rbitscan((mbSize * 1024 * 1024) / sizeof(uint64_t));
+
+    if(newEntryCount == entryCount)
+        return;
+
+    entryCount = newEntryCount;
+    table.reset(new std::atomic<uint64_t>[entryCount]);
+    clear();
+}
+
+void EvalCache::clear() {
+    for(size_t i = 0; i < entryCount; ++i) {
+        table[i].store(0, std::memory_order_relaxed);
+    }
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+
 #include "utils.h"
 #include "defines.h"
 
@@ -65,4 +68,34 @@ private:
     uint8_t generation8;
 };
 
-extern TranspositionTable TT;
\ No newline at end of file
+extern TranspositionTable TT;
+
+// Static evaluations shared by all threads. Each entry packs the upper 48 bits of the
+// position key with the 16 bit value into one word, so a probe never sees half of
+// another thread's write and no locking is needed.
+class EvalCache {
+public:
+    bool probe(const Key key, Value& value) const {
+        uint64_t data = table[key & (entryCount - 1)].load(std::memory_order_relaxed);
+
+        if((data ^ key) >> 16) {
+            return false;
+        }
+
+        value = Value(int16_t(data & 0xFFFF));
+        return true;
+    }
+
+    void save(const Key key, Value value) {
+        table[key & (entryCount - 1)].store((key & ~uint64_t(0xFFFF)) | uint16_t(value), std::memory_order_relaxed);
+    }
+
+    void resize(size_t mbSize);
+    void clear();
+
+private:
+    size_t entryCount = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> table;
+};
+
+extern EvalCache EvalHash;
\ No newline at end of file
@@ -0,0 +1,531 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "evaluate.h"
+#include "material.h"
+#include "thread.h"
+#include "tune.h"
+
+namespace {
+
+    // One weight or table of weights in weights.h
+    struct Term {
+        const char* name;
+        const Score* weights;
+        int dimensions;
+        int rows;
+        int columns;
+        const int* lengths; // Entries in use on each row of a table indexed by piece type
+        bool safety;
+    };
+
+    Term weight(const char* name, const Score& weight, bool safety = false) {
+        return { name, &weight, 0, 1, 1, nullptr, safety };
+    }
+
+    template<size_t Size>
+    Term weight(const char* name, const Score (&weights)[Size]) {
+        return { name, weights, 1, 1, int(Size), nullptr, false };
+    }
+
+    template<size_t Rows, size_t Columns>
+    Term weight(const char* name, const Score (&weights)[Rows][Columns], const int* lengths = nullptr) {
+        return { name, weights[0], 2, int(Rows), int(Columns), lengths, false };
+    }
+
+    constexpr int MobilityLengths[6] = { 0, 0, 9, 14, 15, 28 };
+    constexpr int SquareLengths[PIECE_TYPE_COUNT] = { 0, 64, 64, 64, 64, 64, 64 };
+    const char* PieceNames[PIECE_TYPE_COUNT] = { "", "Pawn", "Knight", "Bishop", "Rook", "Queen", "King" };
+
+    // In the order they are written out. The material values are left alone, as the
+    // search uses them too, and the square tables can move a whole piece type anyway.
+    const Term Terms[] = {
+        weight("weakSquare", weakSquare, true),
+        weight("hangingPiece", hangingPiece),
+        weight("doubledPawn", doubledPawn),
+        weight("isolatedPawn", isolatedPawn),
+        weight("minorBehindPawn", minorBehindPawn),
+        weight("knightOutpost", knightOutpost),
+        weight("bishopOutpost", bishopOutpost),
+        weight("bishopPair", bishopPair),
+        weight("rookOnSeventh", rookOnSeventh),
+        weight("blockedPawnStorm", blockedPawnStorm),
+        weight("unblockedPawnStorm", unblockedPawnStorm),
+        weight("pawnShelter", pawnShelter),
+        weight("safeQueenCheckScore", safeQueenCheckScore, true),
+        weight("safeRookCheckScore", safeRookCheckScore, true),
+        weight("safeBishopCheckScore", safeBishopCheckScore, true),
+        weight("safeKnightCheckScore", safeKnightCheckScore, true),
+        weight("threatBySafePawn", threatBySafePawn),
+        weight("threatByPawnPush", threatByPawnPush),
+        weight("threatByMinor", threatByMinor),
+        weight("threatByRook", threatByRook),
+        weight("threatByKing", threatByKing),
+        weight("mobilityBonus", mobilityBonus, MobilityLengths),
+        weight("passedRank", passedRank),
+        weight("kingDefenders", kingDefenders),
+        weight("pieceSquareBonus", pieceSquareBonus, SquareLengths)
+    };
+
+    constexpr int TermCount = sizeof(Terms) / sizeof(Terms[0]);
+
+    // Where each term starts among the parameters, and which parameters feed king safety
+    int termOffsets[TermCount];
+    int safetySlots[TermCount];
+    int safetyIndices[Tune::SafetyTerms];
+    int parameterCount = 0;
+
+    void initParameters() {
+        int slot = 0;
+
+        parameterCount = 0;
+        for(int i = 0; i < TermCount; ++i) {
+            termOffsets[i] = parameterCount;
+            safetySlots[i] = Terms[i].safety ? slot : -1;
+
+            if(Terms[i].safety) {
+                safetyIndices[slot++] = parameterCount;
+            }
+
+            parameterCount += Terms[i].rows * Terms[i].columns;
+        }
+
+        assert(slot == Tune::SafetyTerms);
+    }
+
+    // The counts are stored in tenths, which is exact for the fractions the evaluation uses
+    constexpr double CountScale = 10;
+
+    struct Coefficient {
+        uint16_t index;
+        int16_t count;
+    };
+
+    // A traced position. Its coefficients follow those of the entry before it in the pool.
+    struct Entry {
+        float result;
+        float remainder[PHASE_NB]; // Whatever the weights do not cover, such as the material values
+        uint32_t end;
+        int16_t phase;
+        uint8_t scale[COLOUR_COUNT];
+        int8_t safety[COLOUR_COUNT][Tune::SafetyTerms];
+    };
+
+    // The positions traced by one thread, which also computes their share of the gradient
+    struct Slice {
+        std::vector<Entry> entries;
+        std::vector<Coefficient> coefficients;
+    };
+
+    struct Evaluation {
+        double mg, eg;
+        double mgFactor, egFactor;
+        double safety[COLOUR_COUNT][PHASE_NB];
+        double value;
+    };
+
+    // Evaluate::value again, but from the counts and from white's point of view
+    Evaluation evaluate(const Entry& entry, const Coefficient* coefficient, const Coefficient* end, const std::vector<double>& weights) {
+        Evaluation evaluation;
+
+        evaluation.mg = entry.remainder[MG];
+        evaluation.eg = entry.remainder[EG];
+
+        for(; coefficient != end; ++coefficient) {
+            evaluation.mg += coefficient->count * weights[2 * coefficient->index + MG] / CountScale;
+            evaluation.eg += coefficient->count * weights[2 * coefficient->index + EG] / CountScale;
+        }
+
+        // As at the end of Evaluate::kingScore
+        for(Colour colour : { WHITE, BLACK }) {
+            double mg = 0, eg = 0, sign = colour == WHITE ? 1 : -1;
+
+            for(int j = 0; j < Tune::SafetyTerms; ++j) {
+                mg += entry.safety[colour][j] * weights[2 * safetyIndices[j] + MG];
+                eg += entry.safety[colour][j] * weights[2 * safetyIndices[j] + EG];
+            }
+
+            evaluation.safety[colour][MG] = mg;
+            evaluation.safety[colour][EG] = eg;
+            evaluation.mg -= sign * eg * std::max(eg, 0.0) / 720;
+            evaluation.eg -= sign * std::max(mg, 0.0) / 20;
+        }
+
+        int scale = entry.scale[evaluation.eg > 0 ? WHITE : BLACK];
+
+        evaluation.mgFactor = (256 - entry.phase) / 256.0;
+        evaluation.egFactor = entry.phase * scale / (256.0 * int(SCALE_FACTOR_NORMAL));
+        evaluation.value = evaluation.mg * evaluation.mgFactor + evaluation.eg * evaluation.egFactor;
+
+        return evaluation;
+    }
+
+    double sigmoid(double k, double value) {
+        return 1 / (1 + std::pow(10.0, -k * value / 400));
+    }
+
+    // Runs work(i) for every slice, each on a thread of its own
+    template<typename Function>
+    void parallel(size_t count, Function work) {
+        std::vector<std::thread> workers;
+
+        for(size_t i = 0; i < count; ++i) {
+            workers.emplace_back(work, i);
+        }
+        for(std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Reads the result from whatever follows the first four fields of the FEN
+    bool parse(const std::string& line, std::string& fen, float& result) {
+        std::istringstream is(line);
+        std::string board, side, castling, enPassant, rest;
+
+        if(!(is >> board >> side >> castling >> enPassant)) {
+            return false;
+        }
+
+        fen = board + " " + side + " " + castling + " " + enPassant + " 0 1";
+        std::getline(is, rest);
+
+        if(rest.find("1/2-1/2") != std::string::npos) {
+            result = 0.5f;
+            return true;
+        }
+        if(rest.find("1-0") != std::string::npos || rest.find("0-1") != std::string::npos) {
+            result = rest.find("1-0") != std::string::npos ? 1.0f : 0.0f;
+            return true;
+        }
+
+        std::replace_if(rest.begin(), rest.end(), [](char c) { return c == '[' || c == ']' || c == '"' || c == ';'; }, ' ');
+
+        std::istringstream fields(rest);
+        std::string field, last;
+
+        while(fields >> field) {
+            last = field;
+        }
+
+        char* parsed = nullptr;
+        double value = std::strtod(last.c_str(), &parsed);
+
+        result = float(value);
+        return !last.empty() && *parsed == '\0' && (value == 0.0 || value == 0.5 || value == 1.0);
+    }
+
+    void trace(Thread* thread, const std::vector<std::string>& lines, size_t begin, size_t end, Slice& slice, const std::vector<double>& weights) {
+        Tune::Trace trace;
+        std::string fen;
+        float result = 0;
+
+        for(size_t i = begin; i < end; ++i) {
+            if(!parse(lines[i], fen, result)) {
+                continue;
+            }
+
+            Position position(fen, thread);
+
+            // The known endgames do not use the weights, and checks are rarely quiet
+            if(position.getCheckers() || Material::probe(position)->specializedEval()) {
+                continue;
+            }
+
+            trace.coefficients.assign(parameterCount, 0.0);
+            std::fill(&trace.safety[0][0], &trace.safety[0][0] + COLOUR_COUNT * Tune::SafetyTerms, 0.0);
+
+            Evaluate<true>(position, trace).value();
+
+            Entry entry = {};
+            entry.result = result;
+            entry.phase = int16_t(trace.phase);
+
+            for(Colour colour : { WHITE, BLACK }) {
+                entry.scale[colour] = uint8_t(trace.scale[colour]);
+
+                for(int j = 0; j < Tune::SafetyTerms; ++j) {
+                    entry.safety[colour][j] = int8_t(trace.safety[colour][j]);
+                }
+            }
+
+            size_t first = slice.coefficients.size();
+
+            for(int index = 0; index < parameterCount; ++index) {
+                if(trace.coefficients[index] != 0) {
+                    slice.coefficients.push_back({ uint16_t(index), int16_t(std::lround(trace.coefficients[index] * CountScale)) });
+                }
+            }
+
+            entry.end = uint32_t(slice.coefficients.size());
+
+            Evaluation evaluation = evaluate(entry, slice.coefficients.data() + first, slice.coefficients.data() + entry.end, weights);
+
+            entry.remainder[MG] = float(double(trace.score.value(0, 1)) - evaluation.mg);
+            entry.remainder[EG] = float(double(trace.score.value(1, 1)) - evaluation.eg);
+            slice.entries.push_back(entry);
+        }
+    }
+
+    // The mean squared error of the predicted results, and its gradient when asked for
+    double error(const std::vector<Slice>& slices, const std::vector<double>& weights, double k, std::vector<double>* gradient = nullptr) {
+        std::vector<double> errors(slices.size(), 0.0);
+        std::vector<std::vector<double>> gradients(slices.size());
+        size_t count = 0;
+
+        parallel(slices.size(), [&](size_t i) {
+            const Slice& slice = slices[i];
+            std::vector<double>& local = gradients[i];
+
+            if(gradient) {
+                local.assign(weights.size(), 0.0);
+            }
+
+            for(size_t n = 0; n < slice.entries.size(); ++n) {
+                const Entry& entry = slice.entries[n];
+                const Coefficient* begin = slice.coefficients.data() + (n ? slice.entries[n - 1].end : 0);
+                const Coefficient* end = slice.coefficients.data() + entry.end;
+
+                Evaluation evaluation = evaluate(entry, begin, end, weights);
+                double predicted = sigmoid(k, evaluation.value);
+
+                errors[i] += (entry.result - predicted) * (entry.result - predicted);
+
+                if(!gradient) {
+                    continue;
+                }
+
+                double g = -2 * (entry.result - predicted) * predicted * (1 - predicted) * k * std::log(10.0) / 400;
+
+                for(const Coefficient* coefficient = begin; coefficient != end; ++coefficient) {
+                    local[2 * coefficient->index + MG] += g * coefficient->count / CountScale * evaluation.mgFactor;
+                    local[2 * coefficient->index + EG] += g * coefficient->count / CountScale * evaluation.egFactor;
+                }
+
+                for(Colour colour : { WHITE, BLACK }) {
+                    double sign = colour == WHITE ? 1 : -1;
+                    double mg = evaluation.safety[colour][MG], eg = evaluation.safety[colour][EG];
+
+                    for(int j = 0; j < Tune::SafetyTerms; ++j) {
+                        if(eg > 0) {
+                            local[2 * safetyIndices[j] + EG] -= g * sign * entry.safety[colour][j] * 2 * eg / 720 * evaluation.mgFactor;
+                        }
+                        if(mg > 0) {
+                            local[2 * safetyIndices[j] + MG] -= g * sign * entry.safety[colour][j] / 20 * evaluation.egFactor;
+                        }
+                    }
+                }
+            }
+        });
+
+        double sum = 0;
+
+        for(size_t i = 0; i < slices.size(); ++i) {
+            sum += errors[i];
+            count += slices[i].entries.size();
+        }
+
+        if(gradient) {
+            gradient->assign(weights.size(), 0.0);
+
+            for(const std::vector<double>& local : gradients) {
+                for(size_t j = 0; j < local.size(); ++j) {
+                    (*gradient)[j] += local[j] / count;
+                }
+            }
+        }
+
+        return sum / count;
+    }
+
+    // The scale of the sigmoid that fits the current weights best. The error has a
+    // single minimum in it, so a ternary search finds it.
+    double fitScale(const std::vector<Slice>& slices, const std::vector<double>& weights) {
+        double low = 0, high = 4;
+
+        for(int i = 0; i < 40; ++i) {
+            double left = low + (high - low) / 3;
+            double right = high - (high - low) / 3;
+
+            if(error(slices, weights, left) < error(slices, weights, right)) {
+                high = right;
+            }
+            else {
+                low = left;
+            }
+        }
+
+        return (low + high) / 2;
+    }
+
+    std::string score(const std::vector<double>& weights, int index) {
+        std::ostringstream ss;
+
+        ss << "S(" << std::lround(weights[2 * index + MG]) << ", " << std::lround(weights[2 * index + EG]) << ")";
+
+        return ss.str();
+    }
+
+    // Four weights to a line, as weights.h was laid out by hand
+    void writeRow(std::ostream& out, const std::vector<double>& weights, int first, int count, const char* indent) {
+        for(int i = 0; i < count; ++i) {
+            out << (i % 4 ? " " : indent) << score(weights, first + i) << "," << (i % 4 == 3 || i == count - 1 ? "\n" : "");
+        }
+    }
+
+    bool write(const std::string& fileName, const std::vector<double>& weights) {
+        std::ofstream out(fileName);
+
+        out << "#pragma once\n\n#include \"defines.h\"\n\n"
+            << "// Tuned by the tune command from the previous weights in here, which it\n"
+            << "// rewrites on every run\n";
+
+        for(int i = 0; i < TermCount; ++i) {
+            const Term& term = Terms[i];
+            int offset = termOffsets[i];
+
+            out << "\ninline constexpr Score " << term.name;
+
+            if(term.dimensions == 0) {
+                out << " = " << score(weights, offset) << ";\n";
+                continue;
+            }
+            if(term.dimensions == 2) {
+                out << "[" << term.rows << "]";
+            }
+            out << "[" << term.columns << "] = {\n";
+
+            if(term.dimensions == 1) {
+                writeRow(out, weights, offset, term.columns, "    ");
+            }
+            else {
+                for(int row = 0; row < term.rows; ++row) {
+                    int length = term.lengths ? term.lengths[row] : term.columns;
+
+                    if(!length) {
+                        out << "    { },\n";
+                        continue;
+                    }
+
+                    out << "    {" << (term.lengths ? std::string(" // ") + PieceNames[row] : "") << "\n";
+                    writeRow(out, weights, offset + row * term.columns, length, "        ");
+                    out << "    },\n";
+                }
+            }
+
+            out << "};\n";
+        }
+
+        return bool(out);
+    }
+}
+
+void Tune::Trace::add(const Score& weight, Colour colour, double count) {
+    std::less<const Score*> before;
+
+    for(int i = 0; i < TermCount; ++i) {
+        const Term& term = Terms[i];
+
+        if(before(&weight, term.weights) || !before(&weight, term.weights + term.rows * term.columns)) {
+            continue;
+        }
+
+        if(term.safety) {
+            safety[colour][safetySlots[i]] += count;
+        }
+        else {
+            coefficients[termOffsets[i] + (&weight - term.weights)] += colour == WHITE ? count : -count;
+        }
+
+        return;
+    }
+}
+
+void Tune::tune(const std::string& fileName, int iterations, const std::string& output) {
+    constexpr size_t BatchSize = 1 << 20;
+    constexpr double LearningRate = 1.0, Beta1 = 0.9, Beta2 = 0.999, Epsilon = 1e-8;
+
+    std::ifstream file(fileName);
+
+    if(!file) {
+        sync_cout << "info string cannot open " << fileName << sync_endl;
+        return;
+    }
+
+    initParameters();
+
+    std::vector<double> weights(2 * parameterCount);
+
+    for(int i = 0; i < TermCount; ++i) {
+        for(int j = 0; j < Terms[i].rows * Terms[i].columns; ++j) {
+            weights[2 * (termOffsets[i] + j) + MG] = Terms[i].weights[j].value(0, 1);
+            weights[2 * (termOffsets[i] + j) + EG] = Terms[i].weights[j].value(1, 1);
+        }
+    }
+
+    // The file is read a batch at a time, so only the traced positions stay in memory
+    std::vector<Slice> slices(Threads.size());
+    std::vector<std::string> lines;
+    std::string line;
+    size_t positions = 0;
+
+    while(file) {
+        lines.clear();
+
+        while(lines.size() < BatchSize && std::getline(file, line)) {
+            lines.push_back(line);
+        }
+
+        parallel(slices.size(), [&](size_t i) {
+            trace(Threads[i], lines, lines.size() * i / slices.size(), lines.size() * (i + 1) / slices.size(), slices[i], weights);
+        });
+    }
+
+    for(const Slice& slice : slices) {
+        positions += slice.entries.size();
+    }
+
+    if(!positions) {
+        sync_cout << "info string no positions in " << fileName << sync_endl;
+        return;
+    }
+
+    double k = fitScale(slices, weights);
+
+    sync_cout << "info string traced " << positions << " positions, scale " << k
+        << " error " << error(slices, weights, k) << sync_endl;
+
+    // Adam, which copes with weights that are used in very different numbers of positions
+    std::vector<double> gradient, momentum(weights.size(), 0.0), velocity(weights.size(), 0.0);
+
+    for(int iteration = 1; iteration <= iterations; ++iteration) {
+        double current = error(slices, weights, k, &gradient);
+
+        for(size_t i = 0; i < weights.size(); ++i) {
+            momentum[i] = Beta1 * momentum[i] + (1 - Beta1) * gradient[i];
+            velocity[i] = Beta2 * velocity[i] + (1 - Beta2) * gradient[i] * gradient[i];
+
+            double m = momentum[i] / (1 - std::pow(Beta1, iteration));
+            double v = velocity[i] / (1 - std::pow(Beta2, iteration));
+
+            weights[i] -= LearningRate * m / (std::sqrt(v) + Epsilon);
+        }
+
+        if(iteration % 100 == 0 || iteration == iterations) {
+            sync_cout << "info string iteration " << iteration << " error " << current << sync_endl;
+        }
+    }
+
+    if(!write(output, weights)) {
+        sync_cout << "info string cannot write " << output << sync_endl;
+        return;
+    }
+
+    sync_cout << "info string wrote " << output << ", error " << error(slices, weights, k) << sync_endl;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "defines.h"
+
+// Texel tuning of the weights in weights.h. The evaluation is linear in nearly all of
+// them, so every position is evaluated only once, to count how often it uses each
+// weight. The weights are then fitted to the game results from those counts alone.
+namespace Tune {
+
+    // Safe checks and weak squares around the king are summed up and then squared, so
+    // their counts are kept apart from the linear terms
+    constexpr int SafetyTerms = 5;
+
+    // What one evaluation used, filled in by the tracing version of Evaluate
+    struct Trace {
+        void add(const Score& weight, Colour colour, double count);
+
+        std::vector<double> coefficients; // White's uses minus black's, per weight
+        double safety[COLOUR_COUNT][SafetyTerms];
+        Score score; // From white's point of view
+        int phase;
+        int scale[COLOUR_COUNT];
+    };
+
+    // tune <file.epd> [iterations] [output]. Each line holds a FEN and the game result as
+    // 1-0, 0-1 or 1/2-1/2, or as 1.0, 0.0 or 0.5 from white's point of view. The positions
+    // are shared out over the Threads option, and the fitted weights replace weights.h.
+    void tune(const std::string& fileName, int iterations, const std::string& output);
+}
@@ -8,11 +8,14 @@
 
 #include "uci.h"
 #include "movegen.h"
+#include "nnue.h"
+#include "perft.h"
 #include "position.h"
 #include "search.h"
 #include "thread.h"
 #include "time.h"
 #include "tt.h"
+#include "tune.h"
 #include "uci.h"
 
 #define START_POSITION ("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")
@@ -24,7 +27,7 @@ using namespace std;
 namespace {
     const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
-    Search::UndoStackPtr SetupUndo;
+    Search::StateListPtr SetupStates;
 
     void setUpPosition(Position& position, istringstream& is) {
         Move move;
@@ -46,11 +49,11 @@ namespace {
         }
 
         position.init(fen, Threads.main());
-        SetupUndo = Search::UndoStackPtr(new std::stack<Undo>);
+        SetupStates = Search::StateListPtr(new std::deque<StateInfo>);
 
         while(is >> token && (move = UCI::to_move(position, token)) != NO_MOVE) {
-            SetupUndo->push(Undo());
-            position.makeMove(&SetupUndo->top(), move);
+            SetupStates->emplace_back();
+            position.makeMove(&SetupStates->back(), move);
         }
     }
 
@@ -100,7 +103,154 @@ namespace {
             else if(token == "ponder")    limits.ponder = 1;
         }
 
-        Threads.start_thinking(position, limits, SetupUndo);
+        Threads.start_thinking(position, limits, SetupStates);
+    }
+
+    // perft <depth> [threads] [hashMB]. Splits the root moves over the given number of
+    // threads and waits for the result, then puts the pool back to the Threads option.
+    void perft(const Position& position, istringstream& is) {
+        Search::LimitsType limits;
+        int depth = 1, threads = Options["Threads"], hash = 16;
+
+        limits.startTime = now();
+
+        if(is >> depth && is >> threads) {
+            is >> hash;
+        }
+
+        limits.perft = std::max(depth, 1);
+        Threads.set(std::max(threads, 1));
+        Perft::resize(std::max(hash, 0));
+
+        Threads.start_thinking(position, limits, SetupStates);
+        Threads.main()->wait_for_search_finished();
+        Threads.read_uci_options();
+    }
+
+    // perftsuite <file.epd> [maxDepth] [hashMB]. The positions of the file are shared out
+    // over the Threads option, and the expected counts deeper than maxDepth are skipped.
+    void perftsuite(const Position& position, istringstream& is) {
+        Search::LimitsType limits;
+        string fileName;
+        int maxDepth = MAX_PLY, hash = 16;
+
+        limits.startTime = now();
+
+        if(is >> fileName >> maxDepth) {
+            is >> hash;
+        }
+
+        if(!Perft::load_suite(fileName)) {
+            sync_cout << "info string cannot open " << fileName << sync_endl;
+            return;
+        }
+
+        limits.perft = std::max(maxDepth, 1);
+        Perft::resize(std::max(hash, 0));
+
+        Threads.start_thinking(position, limits, SetupStates);
+        Threads.main()->wait_for_search_finished();
+    }
+
+    // Plays random games from the current position and checks after every move that the
+    // incrementally updated keys match a full recompute, and that undoing restores it
+    void verify(Position& position, istringstream& is) {
+        int games = 100, plies = 200;
+        uint64_t checked = 0, mismatches = 0;
+
+        is >> games >> plies;
+        plies = std::min(plies, MAX_GAME_PLY - Threads.main()->keyHistory.size() - 1);
+
+        std::vector<StateInfo> states(std::max(plies, 0));
+        std::vector<Move> played(states.size());
+
+        for(int game = 0; game < games; ++game) {
+            int ply = 0;
+
+            for(; ply < plies; ++ply) {
+                ExtMove moveList[MAX_MOVES];
+                int moveCount = generateLegalMoves(position, moveList);
+                Key before = position.getPositionKey();
+
+                if(!moveCount || position.checkDraw(0)) {
+                    break;
+                }
+
+                Move move = moveList[utils::rand_int(0, moveCount - 1)];
+                bool nullMove = !position.getCheckers() && utils::rand_int(0, 9) == 0;
+
+                if(nullMove) {
+                    position.makeNullMove(&states[ply]);
+                    move = NULL_MOVE;
+                }
+                else {
+                    position.makeMove(&states[ply], move);
+                }
+
+                played[ply] = move;
+                ++checked;
+
+                if(position.getPositionKey() != position.generatePositionKey()
+                    || position.getPawnKey() != position.generatePawnKey()
+                    || position.getMaterialKey() != position.generateMaterialKey()) {
+                    ++mismatches;
+                    sync_cout << "info string key mismatch after " << UCI::move(move)
+                        << " at ply " << ply << " of game " << game + 1 << sync_endl;
+                }
+
+                if(NNUE::enabled() && !NNUE::verify(position)) {
+                    ++mismatches;
+                    sync_cout << "info string accumulator mismatch after " << UCI::move(move)
+                        << " at ply " << ply << " of game " << game + 1 << sync_endl;
+                }
+
+                if(nullMove) {
+                    position.undoNullMove();
+                }
+                else {
+                    position.undoMove(move);
+                }
+
+                if(position.getPositionKey() != before) {
+                    ++mismatches;
+                    sync_cout << "info string key not restored after undoing " << UCI::move(move)
+                        << " at ply " << ply << " of game " << game + 1 << sync_endl;
+                }
+
+                if(nullMove) {
+                    position.makeNullMove(&states[ply]);
+                }
+                else {
+                    position.makeMove(&states[ply], move);
+                }
+            }
+
+            while(ply-- > 0) {
+                if(played[ply] == NULL_MOVE) {
+                    position.undoNullMove();
+                }
+                else {
+                    position.undoMove(played[ply]);
+                }
+            }
+        }
+
+        sync_cout << "info string verified " << checked << " positions in " << games
+            << " games, " << mismatches << " key mismatches" << sync_endl;
+    }
+
+    // tune <file.epd> [iterations] [output]. Fits the evaluation weights to the results in
+    // the file and writes them out in the layout of weights.h.
+    void tune(istringstream& is) {
+        string fileName, output = "weights.h";
+        int iterations = 1000;
+
+        if(is >> fileName && is >> iterations) {
+            is >> output;
+        }
+
+        Threads.main()->wait_for_search_finished();
+        Tune::tune(fileName, std::max(iterations, 0), output);
     }
 
 } // namespace
@@ -131,8 +281,9 @@ void UCI::loop(int argc, char* argv[]) {
             Search::Limits.ponder = 0;
         }
         else if(token == "uci") {
-            sync_cout << "\n" << Options
-            << "\nuciok" << sync_endl;
+            sync_cout << "id name " << ENGINE_NAME << " (" << CPU::name() << ")"
+                << "\nid author " << AUTHOR << Options
+                << "\nuciok" << sync_endl;
         }
         else if(token == "ucinewgame") {
             Search::clear();
@@ -143,16 +294,10 @@ void UCI::loop(int argc, char* argv[]) {
         else if(token == "position")   setUpPosition(position, is);
         else if(token == "setoption")  setoption(is);
         else if(token == "d")          position.display();
-        else if(token == "perft") {
-            int depth;
-            stringstream ss;
-
-            is >> depth;
-            ss << Options["Hash"] << " "
-                << Options["Threads"] << " " << depth << " current perft";
-            std::cout << perft(position, Depth(depth), true) << std::endl;
-
-        }
+        else if(token == "verify")     verify(position, is);
+        else if(token == "perft")      perft(position, is);
+        else if(token == "perftsuite") perftsuite(position, is);
+        else if(token == "tune")       tune(is);
         else {
             sync_cout << "Unknown command: " << cmd << sync_endl;
         }
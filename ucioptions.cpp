@@ -3,6 +3,7 @@
 #include <ostream>
 
 #include "utils.h"
+#include "nnue.h"
 #include "search.h"
 #include "thread.h"
 #include "tt.h"
@@ -15,9 +16,28 @@ UCI::OptionsMap Options; // Global object
 namespace UCI {
     void on_clear_hash(const Option&) { Search::clear(); }
     void on_hash_size(const Option& o) { TT.resize(o); }
+    void on_eval_hash_size(const Option& o) { EvalHash.resize(o); }
     void on_logger(const Option& o) { start_logger(o); }
     void on_threads(const Option&) { Threads.read_uci_options(); }
 
+    // Cached evaluations came from whichever backend was active, so they go too
+    void on_nnue(const Option&) {
+        static string loadedFile;
+        string fileName = Options["EvalFile"];
+
+        if(Options["Use NNUE"] && (!NNUE::loaded() || fileName != loadedFile)) {
+            if(NNUE::load(fileName)) {
+                loadedFile = fileName;
+            }
+            else {
+                sync_cout << "info string could not load network " << fileName << sync_endl;
+            }
+        }
+
+        NNUE::setEnabled(Options["Use NNUE"]);
+        EvalHash.clear();
+    }
+
     bool CaseInsensitiveLess::operator() (const string& s1, const string& s2) const {
         return std::lexicographical_compare(s1.begin(), s1.end(), s2.begin(), s2.end(),
             [](char c1, char c2) { return tolower(c1) < tolower(c2); });
@@ -29,6 +49,10 @@ namespace UCI {
         o["Contempt"] << Option(0, -100, 100);
         o["Threads"] << Option(1, 1, 128, on_threads);
         o["Hash"] << Option(16, 1, MaxHashMB, on_hash_size);
+        o["Eval Hash"] << Option(4, 1, 4096, on_eval_hash_size);
+        o["Eval Hash Stats"] << Option(false);
+        o["Use NNUE"] << Option(false, on_nnue);
+        o["EvalFile"] << Option("nn.nnue", on_nnue);
         o["Clear Hash"] << Option(on_clear_hash);
         o["Ponder"] << Option(false);
         o["MultiPV"] << Option(1, 1, 500);
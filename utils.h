@@ -58,4 +58,14 @@ namespace utils {
     {
         vec.erase(std::remove(vec.begin(), vec.end(), val), vec.end());
     }
-}
\ No newline at end of file
+}
+
+// A fixed size table indexed by the low bits of a key. A new entry simply replaces the
+// old one, so callers compare the stored key themselves.
+template<class Entry, int Size>
+struct HashTable {
+    Entry* operator[](uint64_t key) { return &table[uint32_t(key) & (Size - 1)]; }
+
+private:
+    std::vector<Entry> table = std::vector<Entry>(Size);
+};